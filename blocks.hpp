@@ -0,0 +1,610 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * How the memory for `Blocks` is allocated
+ *
+ * With very large populations, random access into blocks (e.g. when choosing fish
+ * at random for harvesting and tagging) is dominated by TLB misses, which huge pages
+ * reduce. On multi-socket machines, interleaving pages across NUMA nodes spreads memory
+ * traffic over all of the nodes' memory controllers. For populations too large to fit
+ * in memory, blocks can instead be mapped from a file (e.g. on a local SSD) so that the
+ * kernel pages them in and out as needed. These options are only available on Linux;
+ * elsewhere (and for the defaults) memory is allocated with `operator new`.
+ * Huge pages and placement are requests to the kernel which it may not fulfil.
+ */
+class Allocation {
+ public:
+
+    /**
+     * Type of pages
+     *
+     * n = normal pages
+     * t = transparent huge pages
+     * e = explicit huge pages (from those reserved in `/proc/sys/vm/nr_hugepages`, falling
+     *     back to transparent huge pages if there are not enough)
+     *
+     * Ignored for file backed memory.
+     */
+    char pages = 'n';
+
+    /**
+     * Placement of pages across NUMA nodes
+     *
+     * f = first touch (the kernel's default: pages are placed on the node of the thread that first
+     *     writes to them)
+     * i = interleaved across all nodes
+     */
+    char placement = 'f';
+
+    /**
+     * Directory for a file backing the memory (empty for anonymous memory)
+     *
+     * A temporary file is created in the directory (and removed immediately so that it
+     * does not outlive the process) and is grown as memory is allocated.
+     */
+    std::string directory;
+
+    /**
+     * Size of huge pages
+     */
+    static const std::size_t huge_page = 1 << 21;
+
+    /**
+     * Memory obtained from `allocate()`
+     */
+    struct Memory {
+        void* address;
+        // Length of the mapping (0 if not mapped)
+        std::size_t mapped;
+        // Offset into the backing file (-1 if not file backed)
+        long long offset;
+    };
+
+    Allocation(void) {}
+
+    /**
+     * Copy the settings (but not the backing file) of another allocation
+     */
+    Allocation(const Allocation& other):
+        pages(other.pages),
+        placement(other.placement),
+        directory(other.directory) {}
+
+    Allocation& operator=(const Allocation& other) {
+        pages = other.pages;
+        placement = other.placement;
+        directory = other.directory;
+        return *this;
+    }
+
+    ~Allocation(void) {
+        #if defined(__linux__)
+            if (descriptor_ >= 0) close(descriptor_);
+        #endif
+    }
+
+    /**
+     * Allocate memory
+     */
+    Memory allocate(std::size_t bytes) {
+        if (pages == 'n' and placement == 'f' and directory.empty()) return {::operator new(bytes), 0, -1};
+        if (pages != 'n' and pages != 't' and pages != 'e') {
+            throw std::runtime_error(std::string("Unknown page type: ") + pages);
+        }
+        if (placement != 'f' and placement != 'i') {
+            throw std::runtime_error(std::string("Unknown page placement: ") + placement);
+        }
+        #if defined(__linux__)
+            if (not directory.empty()) return file(bytes);
+
+            std::size_t page = (pages == 'n') ? sysconf(_SC_PAGESIZE) : huge_page;
+            std::size_t length = (bytes + page - 1) / page * page;
+
+            void* memory = MAP_FAILED;
+            if (pages == 'e') {
+                memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            }
+            if (memory == MAP_FAILED) {
+                // Map an extra huge page so that the memory can be aligned to a huge page
+                // boundary (otherwise the kernel can not back the start and end with huge pages)
+                std::size_t extra = (pages == 'n') ? 0 : huge_page;
+                auto raw = static_cast<char*>(mmap(nullptr, length + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                if (raw == MAP_FAILED) throw std::bad_alloc();
+                auto aligned = raw;
+                if (extra) {
+                    aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(raw) + extra - 1) & ~std::uintptr_t(extra - 1));
+                    if (aligned > raw) munmap(raw, aligned - raw);
+                    auto tail = (raw + length + extra) - (aligned + length);
+                    if (tail > 0) munmap(aligned + length, tail);
+                    madvise(aligned, length, MADV_HUGEPAGE);
+                }
+                memory = aligned;
+            }
+            if (placement == 'i') interleave(memory, length);
+            return {memory, length, -1};
+        #else
+            return {::operator new(bytes), 0, -1};
+        #endif
+    }
+
+    /**
+     * Release memory obtained from `allocate()`
+     *
+     * For file backed memory, the space in the file is also released.
+     */
+    void release(const Memory& memory) {
+        #if defined(__linux__)
+            if (memory.mapped) {
+                munmap(memory.address, memory.mapped);
+                if (memory.offset >= 0 and descriptor_ >= 0) {
+                    fallocate(descriptor_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, memory.offset, memory.mapped);
+                }
+                return;
+            }
+        #endif
+        ::operator delete(memory.address);
+    }
+
+    /**
+     * Advise the kernel how memory will be accessed
+     *
+     * Only has an effect for mapped memory. Most useful for file backed memory,
+     * where sequential access causes pages to be read ahead and dropped soon after use.
+     *
+     * @param access s = sequential, r = random, n = normal
+     */
+    static void advise(const Memory& memory, char access) {
+        #if defined(__linux__)
+            if (not memory.mapped) return;
+            int advice = MADV_NORMAL;
+            if (access == 's') advice = MADV_SEQUENTIAL;
+            else if (access == 'r') advice = MADV_RANDOM;
+            madvise(memory.address, memory.mapped, advice);
+        #endif
+    }
+
+    /**
+     * Get the NUMA nodes that are online (as a bit mask)
+     */
+    static std::vector<unsigned long> nodes(void) {
+        std::vector<unsigned long> mask;
+        std::ifstream file("/sys/devices/system/node/online");
+        std::string list;
+        if (not std::getline(file, list)) return mask;
+        // A list of ranges e.g. "0-1,3"
+        std::istringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            auto dash = range.find('-');
+            unsigned long first = std::stoul(range.substr(0, dash));
+            unsigned long last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (auto node = first; node <= last; node++) {
+                auto word = node / (8 * sizeof(unsigned long));
+                if (mask.size() <= word) mask.resize(word + 1, 0);
+                mask[word] |= 1ul << (node % (8 * sizeof(unsigned long)));
+            }
+        }
+        return mask;
+    }
+
+ private:
+
+    /**
+     * Descriptor of the backing file (-1 if not yet opened)
+     */
+    int descriptor_ = -1;
+
+    /**
+     * Current length of the backing file
+     */
+    long long length_ = 0;
+
+    #if defined(__linux__)
+
+    /**
+     * Allocate memory mapped from the end of the backing file
+     */
+    Memory file(std::size_t bytes) {
+        if (descriptor_ < 0) {
+            std::string path = directory + "/fishes-XXXXXX";
+            std::vector<char> name(path.begin(), path.end());
+            name.push_back(0);
+            descriptor_ = mkstemp(name.data());
+            if (descriptor_ < 0) throw std::runtime_error("Unable to create backing file in: " + directory);
+            unlink(name.data());
+        }
+        std::size_t page = sysconf(_SC_PAGESIZE);
+        std::size_t length = (bytes + page - 1) / page * page;
+        auto offset = length_;
+        if (ftruncate(descriptor_, offset + length) != 0) throw std::bad_alloc();
+        void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor_, offset);
+        if (memory == MAP_FAILED) throw std::bad_alloc();
+        length_ += length;
+        if (placement == 'i') interleave(memory, length);
+        return {memory, length, offset};
+    }
+
+    #endif
+
+    /**
+     * Interleave pages of memory across all online NUMA nodes
+     *
+     * Does nothing if there is only one node. Uses the `mbind` system call
+     * directly to avoid a dependency on `libnuma`.
+     */
+    static void interleave(void* memory, std::size_t length) {
+        #if defined(__linux__) && defined(SYS_mbind)
+            static const auto mask = nodes();
+            unsigned int count = 0;
+            for (auto word : mask) count += __builtin_popcountl(word);
+            if (count < 2) return;
+            const int interleave = 3; // MPOL_INTERLEAVE in <numaif.h>
+            syscall(SYS_mbind, memory, length, interleave, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+        #endif
+    }
+
+};  // class Allocation
+
+/**
+ * A segmented container of items stored in fixed-size blocks
+ *
+ * Used instead of a `std::vector` for large populations (see `Fishes`). When a
+ * vector grows beyond its capacity it allocates a new array, copies every item
+ * into it and then frees the old one, so memory use transiently doubles and all
+ * references to items are invalidated. Here, growth only ever allocates another
+ * block so existing items are never copied or moved and references to them remain
+ * valid (until the item is removed by `erase_if()` or the container is cleared).
+ *
+ * Blocks that are no longer in use (e.g. after `clear()` or `resize()` to a smaller size)
+ * are kept as an arena from which later growth takes blocks before allocating new
+ * ones. `shrink_to_fit()` releases them.
+ *
+ * Items within a block are contiguous so iteration is sequential within each block.
+ * Blocks are also natural units of work for parallel loops (see `blocks()` and `block()`).
+ * Memory for blocks can be allocated from huge pages and interleaved across NUMA nodes
+ * (see `Allocation`).
+ *
+ * @param Item The type of item
+ * @param bits The number of items in each block is `2^bits`
+ */
+template<class Item, unsigned int bits = 16>
+class Blocks {
+ public:
+
+    /**
+     * Number of items in each block
+     */
+    static const unsigned int block_size = 1u << bits;
+
+    /**
+     * How memory for blocks is allocated
+     *
+     * Only applies to blocks allocated after it is changed
+     */
+    Allocation allocation;
+
+    typedef Item value_type;
+    typedef Item& reference;
+    typedef const Item& const_reference;
+
+    Blocks(unsigned int size = 0) {
+        resize(size);
+    }
+
+    Blocks(const Blocks& other) {
+        *this = other;
+    }
+
+    ~Blocks(void) {
+        for (auto& block : blocks_) release(block);
+    }
+
+    Blocks& operator=(const Blocks& other) {
+        if (&other == this) return *this;
+        resize(other.size_);
+        for (unsigned int index = 0; index < other.blocks(); index++) {
+            auto from = other.block(index);
+            std::copy(from.begin(), from.end(), blocks_[index].items);
+        }
+        return *this;
+    }
+
+    /**
+     * Number of items
+     */
+    unsigned int size(void) const {
+        return size_;
+    }
+
+    bool empty(void) const {
+        return size_ == 0;
+    }
+
+    /**
+     * Number of items that can be held without allocating another block
+     */
+    unsigned int capacity(void) const {
+        return blocks_.size() * block_size;
+    }
+
+    Item& operator[](unsigned int index) {
+        return blocks_[index >> bits].items[index & mask_];
+    }
+
+    const Item& operator[](unsigned int index) const {
+        return blocks_[index >> bits].items[index & mask_];
+    }
+
+    /**
+     * Add an item to the end
+     */
+    void push_back(const Item& item) {
+        if (size_ == capacity()) allocate();
+        (*this)[size_++] = item;
+    }
+
+    /**
+     * Change the number of items
+     *
+     * Added items are value initialised
+     */
+    void resize(unsigned int size) {
+        while (capacity() < size) allocate();
+        for (auto index = size_; index < size; index++) (*this)[index] = Item();
+        size_ = size;
+    }
+
+    /**
+     * Remove all items (keeping blocks for reuse)
+     */
+    void clear(void) {
+        size_ = 0;
+    }
+
+    /**
+     * Release blocks that are not in use
+     */
+    void shrink_to_fit(void) {
+        for (auto index = blocks(); index < blocks_.size(); index++) release(blocks_[index]);
+        blocks_.resize(blocks());
+        blocks_.shrink_to_fit();
+    }
+
+    /**
+     * Advise how the blocks in use will be accessed (see `Allocation::advise()`)
+     *
+     * @param access s = sequential, r = random, n = normal
+     */
+    void advise(char access) {
+        for (unsigned int index = 0; index < blocks(); index++) Allocation::advise(blocks_[index].memory, access);
+    }
+
+    /**
+     * Remove items for which a predicate is true
+     *
+     * The order of the remaining items is preserved.
+     *
+     * @return Number of items removed
+     */
+    template<class Predicate>
+    unsigned int erase_if(Predicate predicate) {
+        unsigned int kept = 0;
+        for (unsigned int index = 0; index < size_; index++) {
+            Item& item = (*this)[index];
+            if (predicate(item)) continue;
+            if (kept != index) (*this)[kept] = item;
+            kept++;
+        }
+        auto removed = size_ - kept;
+        size_ = kept;
+        return removed;
+    }
+
+    /**
+     * A contiguous range of items in a block
+     */
+    template<class Type>
+    class Range {
+     public:
+        Range(Type* begin, Type* end):
+            begin_(begin),
+            end_(end) {}
+
+        Type* begin(void) const {
+            return begin_;
+        }
+
+        Type* end(void) const {
+            return end_;
+        }
+
+        unsigned int size(void) const {
+            return end_ - begin_;
+        }
+
+     private:
+        Type* begin_;
+        Type* end_;
+    };
+
+    /**
+     * Number of blocks in use
+     */
+    unsigned int blocks(void) const {
+        return (size_ + block_size - 1) >> bits;
+    }
+
+    /**
+     * The items in a block
+     *
+     * Blocks do not share items so they can be processed concurrently
+     * e.g. by submitting a task for each block to a `Pool`
+     */
+    Range<Item> block(unsigned int index) {
+        Item* begin = blocks_[index].items;
+        return Range<Item>(begin, begin + block_length(index));
+    }
+
+    Range<const Item> block(unsigned int index) const {
+        const Item* begin = blocks_[index].items;
+        return Range<const Item>(begin, begin + block_length(index));
+    }
+
+    /**
+     * Forward iterator over all items, block by block
+     */
+    template<class Container, class Type>
+    class Iterator {
+     public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Type* pointer;
+        typedef Type& reference;
+
+        Iterator(Container* container, unsigned int block):
+            container_(container),
+            block_(block),
+            item_(nullptr),
+            end_(nullptr) {
+            enter();
+        }
+
+        Type& operator*(void) const {
+            return *item_;
+        }
+
+        Type* operator->(void) const {
+            return item_;
+        }
+
+        Iterator& operator++(void) {
+            if (++item_ == end_) {
+                block_++;
+                enter();
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return item_ == other.item_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return item_ != other.item_;
+        }
+
+     private:
+        Container* container_;
+        unsigned int block_;
+        Type* item_;
+        Type* end_;
+
+        void enter(void) {
+            if (block_ < container_->blocks()) {
+                auto range = container_->block(block_);
+                item_ = range.begin();
+                end_ = range.end();
+            } else {
+                item_ = nullptr;
+                end_ = nullptr;
+            }
+        }
+    };
+
+    typedef Iterator<Blocks, Item> iterator;
+    typedef Iterator<const Blocks, const Item> const_iterator;
+
+    iterator begin(void) {
+        return iterator(this, 0);
+    }
+
+    iterator end(void) {
+        return iterator(this, blocks());
+    }
+
+    const_iterator begin(void) const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end(void) const {
+        return const_iterator(this, blocks());
+    }
+
+ private:
+
+    static const unsigned int mask_ = block_size - 1;
+
+    /**
+     * Number of items
+     */
+    unsigned int size_ = 0;
+
+    struct Block {
+        Item* items;
+        Allocation::Memory memory;
+    };
+
+    /**
+     * Blocks (those beyond `blocks()` are not in use)
+     */
+    std::vector<Block> blocks_;
+
+    /**
+     * Allocate another block
+     *
+     * Items are default initialised so, if they are trivial, memory is not
+     * written to (and pages are placed when they are first written to)
+     */
+    void allocate(void) {
+        auto memory = allocation.allocate(block_size * sizeof(Item));
+        auto items = static_cast<Item*>(memory.address);
+        for (unsigned int index = 0; index < block_size; index++) new (items + index) Item;
+        blocks_.push_back({items, memory});
+    }
+
+    void release(Block& block) {
+        for (unsigned int index = 0; index < block_size; index++) block.items[index].~Item();
+        allocation.release(block.memory);
+    }
+
+    /**
+     * Number of items in a block
+     */
+    unsigned int block_length(unsigned int index) const {
+        return std::min(size_ - (index << bits), block_size);
+    }
+
+};  // class Blocks
+
+template<class Item, unsigned int bits>
+const unsigned int Blocks<Item, bits>::block_size;
+
+template<class Item, unsigned int bits>
+const unsigned int Blocks<Item, bits>::mask_;
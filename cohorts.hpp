@@ -0,0 +1,595 @@
+#pragma once
+
+#include <boost/math/distributions/normal.hpp>
+
+#include "context.hpp"
+#include "fishes.hpp"
+#include "harvest.hpp"
+#include "monitor.hpp"
+
+/**
+ * A cohort-matrix (aggregate) model of the population
+ *
+ * An alternative to the individual-based model which projects numbers of fish
+ * by region, sex, age and length (the same structure as `Fishes::counts`) directly.
+ * Natural processes are the same as for individual `Fish` (although as averages
+ * over cells rather than for each fish) and harvesting uses the selectivities of
+ * `Harvest` and is recorded by a `Monitor` so that outputs are comparable with
+ * those from `Model`. Much faster than the individual-based model so is useful for
+ * screening and as a burn-in for it (see `individuals()` and `fishes_burnin`).
+ *
+ * Approximations relative to the individual-based model:
+ *
+ *  - growth is a Markov transition between length bins averaged over the distribution of
+ *    growth parameters i.e. individual fish do not keep their growth parameters for life
+ *  - fish within a length bin are assumed to be at its mid-point (e.g. for weight and MLS)
+ *  - catch is taken as an exploitation rate (capped at `exploitation_max`) on
+ *    vulnerable biomass rather than by taking fish one at a time
+ *  - home fidelity movement, tagging and shyness are not represented
+ *  - age and length samples are of numbers caught (rather than instances caught)
+ */
+class Cohorts {
+ public:
+
+    Context context;
+    Harvest harvest;
+    Monitor monitor;
+
+    /**
+     * Numbers of fish by region, sex, age and length
+     */
+    Array<double, Regions, Sexes, Ages, Lengths> numbers;
+
+    /**
+     * Numbers of mature fish by region, sex, age and length
+     */
+    Array<double, Regions, Sexes, Ages, Lengths> mature;
+
+    /**
+     * Current spawner biomass (t)
+     */
+    Array<double, Regions> biomass_spawners;
+
+    /**
+     * Recruitment for pristine population
+     */
+    Array<double, Regions> recruitment_pristine;
+
+    /**
+     * Current recruitment (no.)
+     */
+    Array<double, Regions> recruitment;
+
+    /**
+     * Survival mode
+     *
+     * d = deterministic (numbers in each cell are multiplied by survival rate)
+     * m = multinomial (numbers surviving in each cell are binomially distributed)
+     */
+    char survival_mode = 'd';
+
+    /**
+     * Maximum exploitation rate for each method in each region
+     */
+    double exploitation_max = 0.9;
+
+    void initialise(void) {
+        context.parameters.initialise();
+        initialise(context.parameters);
+    }
+
+    /**
+     * Initialise using parameters that have already been read in
+     */
+    void initialise(const Parameters& parameters) {
+        if (&parameters != &context.parameters) context.parameters = parameters;
+        if (context.parameters.fishes_movement_type == 'h') {
+            throw std::runtime_error("Home fidelity movement is not available for cohorts");
+        }
+        harvest.initialise(context);
+        monitor.initialise();
+        numbers = 0;
+        mature = 0;
+
+        for (auto length : lengths) {
+            weights_(length) = context.parameters.fishes_a * std::pow(mid(length.index()), context.parameters.fishes_b);
+        }
+        growth_init();
+    }
+
+    void finalise(std::string directory = "output/cohorts") {
+        monitor.finalise(context, directory + "/monitor");
+    }
+
+    /**
+     * Update the population for a time step
+     */
+    void update(void) {
+        auto& parameters = context.parameters;
+        auto y = year(context.now);
+        bool burnin = (y < Years_min);
+
+        if (not burnin) monitor.reset(context);
+
+        /*****************************************************************
+         * Spawning and recruitment
+         ****************************************************************/
+
+        biomass_spawners_update();
+        recruitment_update();
+        for (auto region : regions) {
+            numbers(region, male, 0, 0) += recruitment(region) * parameters.fishes_males;
+            numbers(region, female, 0, 0) += recruitment(region) * (1 - parameters.fishes_males);
+        }
+
+        /*****************************************************************
+         * Population dynamics
+         ****************************************************************/
+
+        survival();
+        growth();
+        maturation();
+        movement();
+
+        if (not burnin) {
+            for (auto region : regions) {
+                double number = 0;
+                for (auto sex : sexes) {
+                    for (auto age : ages) {
+                        for (auto length : lengths) {
+                            auto value = numbers(region, sex, age, length);
+                            number += value;
+                            monitor.population_lengths_sample(region, length) += value;
+                        }
+                    }
+                }
+                monitor.population_numbers(y, region) += std::round(number);
+            }
+        }
+
+        if (not burnin) {
+            harvesting();
+            biomass_vulnerable_update();
+            monitor.update(context, biomass_spawners, harvest);
+        }
+
+        aging();
+    }
+
+    /**
+     * Take the population to pristine equilibrium
+     *
+     * As for `Model::pristine()`, recruitment is held constant during a burn in
+     * and then numbers are scaled so that spawner biomass equals `fishes_b0`
+     * (always with deterministic survival)
+     */
+    void pristine(Time time) {
+        auto& parameters = context.parameters;
+        auto& now = context.now;
+        now = 200;
+        numbers = 0;
+        mature = 0;
+        mode_ = 'p';
+        // Burn in is done at an arbitrary scale (before scaling to `fishes_b0`)
+        // so survival must be deterministic
+        auto saved = survival_mode;
+        survival_mode = 'd';
+        for (auto region : regions) {
+            recruitment_pristine(region) = parameters.fishes_b0(region)/sum(parameters.fishes_b0);
+        }
+        for (int step = 0; step < 100; step++) {
+            update();
+            now++;
+        }
+        biomass_spawners_update();
+        auto scalar = sum(parameters.fishes_b0)/sum(biomass_spawners);
+        numbers *= scalar;
+        mature *= scalar;
+        biomass_spawners *= scalar;
+        recruitment_pristine *= scalar;
+        now = time;
+        mode_ = 'n';
+        survival_mode = saved;
+    }
+
+    /**
+     * Run the model over a time period, starting in pristine conditions
+     */
+    void run(Time start, Time finish, std::function<void()>* callback = 0) {
+        pristine(start);
+        context.now = start;
+        while (context.now <= finish) {
+            update();
+            if (callback) (*callback)();
+            context.now++;
+        }
+    }
+
+    /**
+     * Create individuals from the numbers in each cell
+     *
+     * Used to start the individual-based model from the cohort model (e.g. after
+     * a cohort burn in). Fish are seeded as for `Fishes::seed()` but their region,
+     * sex, age, length and maturity are taken from a randomly chosen cell.
+     *
+     * @param context The context of the individual-based model
+     * @param fishes The population to seed
+     * @param number The (approximate) number of instances to create
+     */
+    void individuals(Context& context, Fishes& fishes, unsigned int number) const {
+        fishes.clear();
+        double total = sum(numbers);
+        unsigned int index = 0;
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto age : ages) {
+                    for (auto length : lengths) {
+                        auto cell = numbers(region, sex, age, length);
+                        if (cell <= 0) continue;
+                        double expected = cell/total * number;
+                        unsigned int instances = expected;
+                        if (context.chance() < expected - instances) instances++;
+                        double proportion_mature = mature(region, sex, age, length)/cell;
+                        for (unsigned int instance = 0; instance < instances; instance++) {
+                            Fish fish;
+                            fish.seed(context, index++);
+                            fish.home = Region(region.index());
+                            fish.region = fish.home;
+                            fish.sex = Sex(sex.index());
+                            fish.birth = context.now - age.index();
+                            fish.length = (length.index() + context.chance()) * length_bin_width;
+                            fish.mature = context.chance() < proportion_mature;
+                            fishes.push_back(fish);
+                        }
+                    }
+                }
+            }
+        }
+        fishes.scalar = total/fishes.size();
+    }
+
+ private:
+
+    /**
+     * Recruitment mode ('p' = pristine, 'n' = normal)
+     */
+    char mode_ = 'n';
+
+    /**
+     * Weight at the mid-point of each length bin
+     */
+    Array<double, Lengths> weights_;
+
+    /**
+     * Growth transition matrix (from length bin by to length bin)
+     */
+    std::vector<double> growth_;
+
+    static double mid(unsigned int length) {
+        return (length + 0.5) * length_bin_width;
+    }
+
+    /**
+     * Calculate the growth transition matrix
+     *
+     * The probability of moving from one length bin to another is averaged over
+     * a sample from the distributions of the growth parameters. Temporal variation
+     * (a normal deviate) is integrated over exactly.
+     */
+    void growth_init(void) {
+        auto& parameters = context.parameters;
+        const unsigned int bins = Lengths::size();
+        growth_.assign(bins * bins, 0);
+
+        // Sample of growth parameters (fixed seed so the matrix is the same
+        // for all replicates)
+        Random random(1);
+        Draws draws(random);
+        const unsigned int samples = (parameters.fishes_growth_variation == 't') ? 1 : 200;
+        bool temporal = parameters.fishes_growth_variation == 't' or parameters.fishes_growth_variation == 'm';
+        boost::math::normal normal;
+
+        for (unsigned int sample = 0; sample < samples; sample++) {
+            Context sampling;
+            sampling.parameters = parameters;
+            Fish fish;
+            fish.growth_init(sampling, draws, 0);
+            for (unsigned int from = 0; from < bins; from++) {
+                fish.length = mid(from);
+                double incr = fish.growth_increment(parameters);
+                double* row = &growth_[from * bins];
+                if (not temporal) {
+                    row[length_bin(std::max(fish.length + incr, 0.0))] += 1.0/samples;
+                    continue;
+                }
+                int sd = std::max(parameters.fishes_growth_temporal_sdmin, incr * parameters.fishes_growth_temporal_cv);
+                double floor = parameters.fishes_growth_temporal_incrmin;
+                // Probability of the increment being below the minimum
+                double below = (sd > 0) ? boost::math::cdf(normal, (floor - incr)/sd) : (incr < floor);
+                row[length_bin(std::max(fish.length + floor, 0.0))] += below/samples;
+                // Probability of ending up in each bin given the increment is above the minimum
+                for (unsigned int to = 0; to < bins; to++) {
+                    double lower = std::max(to * length_bin_width - fish.length, floor);
+                    double upper = (to == bins - 1) ? INFINITY : (to + 1) * length_bin_width - fish.length;
+                    if (to == 0) lower = floor;
+                    if (upper <= lower) continue;
+                    double p;
+                    if (sd > 0) {
+                        p = ((upper == INFINITY) ? 1 : boost::math::cdf(normal, (upper - incr)/sd)) -
+                            boost::math::cdf(normal, (lower - incr)/sd);
+                    } else {
+                        p = (incr >= lower and incr < upper);
+                    }
+                    row[to] += p/samples;
+                }
+            }
+        }
+    }
+
+    void biomass_spawners_update(void) {
+        biomass_spawners = 0;
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto age : ages) {
+                    for (auto length : lengths) {
+                        biomass_spawners(region) += mature(region, sex, age, length) * weights_(length);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Update recruitment
+     *
+     * As for `Fishes::recruitment_update()` (and using the same random numbers
+     * when using common random numbers)
+     */
+    void recruitment_update(void) {
+        auto& parameters = context.parameters;
+        auto y = year(context.now);
+        for (auto region : regions) {
+            if (mode_ == 'p') {
+                recruitment(region) = recruitment_pristine(region);
+            } else {
+                auto s = biomass_spawners(region);
+                auto r0 = recruitment_pristine(region);
+                auto s0 = parameters.fishes_b0(region);
+                auto h = parameters.fishes_steepness;
+                auto determ = 4*h*r0*s/((5*h-1)*s+s0*(1-h));
+
+                double strength = parameters.fishes_rec_strengths(y, region);
+                if (strength < 0) {
+                    auto sigma = std::sqrt(std::log(1 + std::pow(parameters.fishes_rec_var, 2)));
+                    auto deviate = context.draws(process_recruitment, region.index()).standard_normal();
+                    strength = std::exp(-sigma*sigma/2 + sigma*deviate);
+                }
+
+                recruitment(region) = determ * strength;
+            }
+        }
+    }
+
+    void survival(void) {
+        auto rate = 1 - context.parameters.fishes_m_rate;
+        if (survival_mode == 'd') {
+            numbers *= rate;
+            mature *= rate;
+        } else if (survival_mode == 'm') {
+            for (auto region : regions) {
+                for (auto sex : sexes) {
+                    for (auto age : ages) {
+                        for (auto length : lengths) {
+                            auto& cell = numbers(region, sex, age, length);
+                            if (cell <= 0) continue;
+                            auto& cell_mature = mature(region, sex, age, length);
+                            // Survivors of the immature and mature fish in the cell
+                            int immature = std::round(cell - cell_mature);
+                            int matured = std::round(cell_mature);
+                            immature = boost::random::binomial_distribution<int>(immature, rate)(context.random);
+                            matured = boost::random::binomial_distribution<int>(matured, rate)(context.random);
+                            cell = immature + matured;
+                            cell_mature = matured;
+                        }
+                    }
+                }
+            }
+        } else {
+            throw std::runtime_error(std::string("Unknown survival mode: ") + survival_mode);
+        }
+    }
+
+    void growth(void) {
+        const unsigned int bins = Lengths::size();
+        std::vector<double> before_numbers(bins);
+        std::vector<double> before_mature(bins);
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto age : ages) {
+                    bool any = false;
+                    for (auto length : lengths) {
+                        before_numbers[length.index()] = numbers(region, sex, age, length);
+                        before_mature[length.index()] = mature(region, sex, age, length);
+                        numbers(region, sex, age, length) = 0;
+                        mature(region, sex, age, length) = 0;
+                        if (before_numbers[length.index()] > 0) any = true;
+                    }
+                    if (not any) continue;
+                    for (unsigned int from = 0; from < bins; from++) {
+                        if (before_numbers[from] <= 0) continue;
+                        const double* row = &growth_[from * bins];
+                        for (unsigned int to = 0; to < bins; to++) {
+                            if (row[to] == 0) continue;
+                            numbers(region, sex, age, to) += before_numbers[from] * row[to];
+                            mature(region, sex, age, to) += before_mature[from] * row[to];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void maturation(void) {
+        auto& parameters = context.parameters;
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto age : ages) {
+                    auto p = parameters.fishes_maturation(age);
+                    if (p <= 0) continue;
+                    for (auto length : lengths) {
+                        auto& cell_mature = mature(region, sex, age, length);
+                        cell_mature += (numbers(region, sex, age, length) - cell_mature) * p;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Move fish between regions
+     *
+     * For an individual fish, a region is chosen at random and the fish
+     * moves there with the probability in `fishes_movement`. So the probability
+     * of moving to another region is a third of that probability.
+     */
+    void movement(void) {
+        auto& parameters = context.parameters;
+        if (parameters.fishes_movement_type == 'n') return;
+
+        Array<double, Regions, RegionTos> transition;
+        for (auto from : regions) {
+            double stay = 1;
+            for (auto to : region_tos) {
+                if (from.index() == to.index()) continue;
+                transition(from, to) = parameters.fishes_movement(from, to)/regions.size();
+                stay -= transition(from, to);
+            }
+            transition(from, from) = stay;
+        }
+
+        for (auto sex : sexes) {
+            for (auto age : ages) {
+                for (auto length : lengths) {
+                    Array<double, Regions> before_numbers;
+                    Array<double, Regions> before_mature;
+                    for (auto region : regions) {
+                        before_numbers(region) = numbers(region, sex, age, length);
+                        before_mature(region) = mature(region, sex, age, length);
+                    }
+                    for (auto to : regions) {
+                        double number = 0;
+                        double matured = 0;
+                        for (auto from : regions) {
+                            number += before_numbers(from) * transition(from, to);
+                            matured += before_mature(from) * transition(from, to);
+                        }
+                        numbers(to, sex, age, length) = number;
+                        mature(to, sex, age, length) = matured;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Take the observed catch from each region by each method
+     *
+     * Exploitation rates are calculated from the biomass that is vulnerable to,
+     * and retained by, each method. Released fish die at `harvest_handling_mortality`.
+     */
+    void harvesting(void) {
+        auto& parameters = context.parameters;
+        harvest.catch_observed_update(context);
+        harvest.attempts = 0;
+        harvest.catch_taken = 0;
+
+        for (auto region : regions) {
+            // Vulnerable and retained biomass by method
+            Array<double, Methods> exploitation;
+            for (auto method : methods) {
+                double retained = 0;
+                for (auto sex : sexes) {
+                    for (auto age : ages) {
+                        for (auto length : lengths) {
+                            if (mid(length.index()) < parameters.harvest_mls(method)) continue;
+                            retained += numbers(region, sex, age, length) * weights_(length) *
+                                harvest.selectivity_at_length(method, length);
+                        }
+                    }
+                }
+                auto catches = harvest.catch_observed(region, method);
+                exploitation(method) = (retained > 0) ? std::min(catches/retained, exploitation_max) : 0;
+            }
+
+            // Proportion of each length bin removed by each method (and in total)
+            for (auto length : lengths) {
+                Array<double, Methods> taken;
+                double removed = 0;
+                for (auto method : methods) {
+                    auto rate = exploitation(method) * harvest.selectivity_at_length(method, length);
+                    bool retained = mid(length.index()) >= parameters.harvest_mls(method);
+                    taken(method) = retained ? rate : 0;
+                    removed += retained ? rate : rate * parameters.harvest_handling_mortality;
+                }
+                // Ensure no more than all the fish are removed
+                double scale = (removed > 1) ? 1/removed : 1;
+                removed *= scale;
+
+                for (auto sex : sexes) {
+                    for (auto age : ages) {
+                        auto& cell = numbers(region, sex, age, length);
+                        if (cell <= 0) continue;
+                        for (auto method : methods) {
+                            auto caught = cell * taken(method) * scale;
+                            if (caught <= 0) continue;
+                            harvest.catch_taken(region, method) += caught * weights_(length);
+                            if (monitor.components.A) monitor.age_sample(region, method, age) += caught;
+                            if (monitor.components.L) monitor.length_sample(region, method, length) += caught;
+                        }
+                        cell *= 1 - removed;
+                        mature(region, sex, age, length) *= 1 - removed;
+                    }
+                }
+            }
+        }
+    }
+
+    void biomass_vulnerable_update(void) {
+        harvest.biomass_vulnerable = 0;
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto age : ages) {
+                    for (auto length : lengths) {
+                        auto biomass = numbers(region, sex, age, length) * weights_(length);
+                        if (biomass <= 0) continue;
+                        for (auto method : methods) {
+                            harvest.biomass_vulnerable(region, method) += biomass * harvest.selectivity_at_length(method, length);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Move fish to the next age (with a plus group)
+     */
+    void aging(void) {
+        const unsigned int last = Ages::size() - 1;
+        for (auto region : regions) {
+            for (auto sex : sexes) {
+                for (auto length : lengths) {
+                    numbers(region, sex, last, length) += numbers(region, sex, last - 1, length);
+                    mature(region, sex, last, length) += mature(region, sex, last - 1, length);
+                    for (unsigned int age = last - 1; age > 0; age--) {
+                        numbers(region, sex, age, length) = numbers(region, sex, age - 1, length);
+                        mature(region, sex, age, length) = mature(region, sex, age - 1, length);
+                    }
+                    numbers(region, sex, 0, length) = 0;
+                    mature(region, sex, 0, length) = 0;
+                }
+            }
+        }
+    }
+
+};  // class Cohorts
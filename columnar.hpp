@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dimensions.hpp"
+
+/**
+ * A sparse, binary, columnar output file
+ *
+ * An alternative to TSV for large, mostly zero, arrays (e.g. `Fishes::counts` and the
+ * age and length samples in `Monitor`). Only non-zero cells are written and values are
+ * stored in binary columns so files are much smaller, and much faster to write and to read,
+ * than the equivalent TSV. Read into R using `read_columnar()` in `scripts/sna1-read-columnar.r`.
+ *
+ * Layout (all numbers are little-endian, strings are a `uint32` length followed by that many bytes):
+ *
+ *   header
+ *     char[8]      "SNA1COLS"
+ *     uint32       version (1)
+ *     uint32       number of dimensions (D)
+ *     D times
+ *       string     name of dimension
+ *       uint32     number of levels (L)
+ *       string[L]  label of each level
+ *     string       name of value
+ *   batches (until the end of the file)
+ *     uint32       number of rows (R)
+ *     D times
+ *       uint16[R]  level of the dimension for each row (an index into the labels, or
+ *                  the level itself if the dimension has no labels e.g. time)
+ *     float64[R]   value for each row
+ *
+ * Cells that are not in the file are zero.
+ */
+class Columnar {
+ public:
+
+    /**
+     * A dimension of the data
+     */
+    struct Dimension {
+        std::string name;
+        std::vector<std::string> labels;
+    };
+
+    Columnar(void) {}
+
+    Columnar(const std::string& path, const std::vector<Dimension>& dimensions, const std::string& value = "value") {
+        open(path, dimensions, value);
+    }
+
+    ~Columnar(void) {
+        close();
+    }
+
+    /**
+     * Open a file and write the header
+     */
+    void open(const std::string& path, const std::vector<Dimension>& dimensions, const std::string& value = "value") {
+        file_.open(path, std::ios::binary);
+        if (not file_) throw std::runtime_error("Unable to open file: " + path);
+        levels_.assign(dimensions.size(), std::vector<uint16_t>());
+        values_.clear();
+
+        file_.write("SNA1COLS", 8);
+        put<uint32_t>(1);
+        put<uint32_t>(dimensions.size());
+        for (const auto& dimension : dimensions) {
+            put(dimension.name);
+            put<uint32_t>(dimension.labels.size());
+            for (const auto& label : dimension.labels) put(label);
+        }
+        put(value);
+    }
+
+    /**
+     * Append a row (if the value is not zero)
+     *
+     * @param levels Level of each dimension
+     */
+    void append(std::initializer_list<unsigned int> levels, double value) {
+        if (value == 0) return;
+        if (levels.size() != levels_.size()) throw std::runtime_error("Wrong number of levels for columnar row");
+        unsigned int dimension = 0;
+        for (auto level : levels) levels_[dimension++].push_back(level);
+        values_.push_back(value);
+    }
+
+    /**
+     * Write the rows appended so far as a batch
+     */
+    void flush(void) {
+        if (not file_.is_open() or values_.empty()) return;
+        put<uint32_t>(values_.size());
+        for (auto& column : levels_) {
+            file_.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(uint16_t));
+            column.clear();
+        }
+        file_.write(reinterpret_cast<const char*>(values_.data()), values_.size() * sizeof(double));
+        values_.clear();
+        file_.flush();
+    }
+
+    void close(void) {
+        if (not file_.is_open()) return;
+        flush();
+        file_.close();
+    }
+
+    /**
+     * The contents of a file (e.g. for testing)
+     */
+    struct Contents {
+        std::vector<Dimension> dimensions;
+        std::string value;
+        std::vector<std::vector<uint16_t>> levels;
+        std::vector<double> values;
+    };
+
+    /**
+     * Read a file
+     */
+    static Contents read(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        char magic[8];
+        file.read(magic, 8);
+        if (not file or std::string(magic, 8) != "SNA1COLS") throw std::runtime_error("Not a columnar file: " + path);
+        get<uint32_t>(file);
+
+        Contents contents;
+        contents.dimensions.resize(get<uint32_t>(file));
+        for (auto& dimension : contents.dimensions) {
+            dimension.name = get(file);
+            dimension.labels.resize(get<uint32_t>(file));
+            for (auto& label : dimension.labels) label = get(file);
+        }
+        contents.value = get(file);
+        contents.levels.resize(contents.dimensions.size());
+
+        while (file.peek() != EOF) {
+            auto rows = get<uint32_t>(file);
+            for (auto& column : contents.levels) {
+                auto start = column.size();
+                column.resize(start + rows);
+                file.read(reinterpret_cast<char*>(column.data() + start), rows * sizeof(uint16_t));
+            }
+            auto start = contents.values.size();
+            contents.values.resize(start + rows);
+            file.read(reinterpret_cast<char*>(contents.values.data() + start), rows * sizeof(double));
+            if (not file) throw std::runtime_error("Truncated columnar file: " + path);
+        }
+        return contents;
+    }
+
+ private:
+
+    std::ofstream file_;
+
+    /**
+     * Levels and values of rows not yet written
+     */
+    std::vector<std::vector<uint16_t>> levels_;
+    std::vector<double> values_;
+
+    template<class Type>
+    void put(Type value) {
+        file_.write(reinterpret_cast<const char*>(&value), sizeof(Type));
+    }
+
+    void put(const std::string& value) {
+        put<uint32_t>(value.size());
+        file_.write(value.data(), value.size());
+    }
+
+    template<class Type>
+    static Type get(std::istream& stream) {
+        Type value;
+        stream.read(reinterpret_cast<char*>(&value), sizeof(Type));
+        return value;
+    }
+
+    static std::string get(std::istream& stream) {
+        std::string value(get<uint32_t>(stream), 0);
+        stream.read(&value[0], value.size());
+        return value;
+    }
+
+};  // class Columnar
+
+
+/**
+ * Dimensions of the model for columnar files
+ */
+
+Columnar::Dimension columnar_years(void) {
+    Columnar::Dimension dimension{"year", {}};
+    for (auto year : years) dimension.labels.push_back(std::to_string(year));
+    return dimension;
+}
+
+Columnar::Dimension columnar_regions(void) {
+    Columnar::Dimension dimension{"region", {}};
+    for (auto region : regions) dimension.labels.push_back(region_code(region));
+    return dimension;
+}
+
+Columnar::Dimension columnar_sexes(void) {
+    return {"sex", {"male", "female"}};
+}
+
+Columnar::Dimension columnar_methods(void) {
+    Columnar::Dimension dimension{"method", {}};
+    for (auto method : methods) dimension.labels.push_back(method_code(method));
+    return dimension;
+}
+
+Columnar::Dimension columnar_ages(void) {
+    Columnar::Dimension dimension{"age", {}};
+    for (auto age : ages) dimension.labels.push_back(std::to_string(age));
+    return dimension;
+}
+
+Columnar::Dimension columnar_lengths(void) {
+    Columnar::Dimension dimension{"length", {}};
+    for (auto length : lengths) dimension.labels.push_back(std::to_string(length));
+    return dimension;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "requirements.hpp"
+#include "random.hpp"
+#include "dimensions.hpp"
+#include "parameters.hpp"
+
+/**
+ * Processes that draw from their own streams when
+ * using common random numbers (see `Context::draws()`)
+ */
+enum Process {
+    process_birth = 1,
+    process_survival = 2,
+    process_growth = 3,
+    process_maturation = 4,
+    process_movement = 5,
+    process_shedding = 6,
+    process_recruitment = 7,
+    process_rescaling = 8,
+    process_detection = 9
+};
+
+
+/**
+ * Random numbers for a process
+ *
+ * Draws either from a context's generator or from a keyed `Stream`.
+ * Satisfies the requirements of a generator so it can be used with
+ * `Distribution::random()`.
+ */
+class Draws {
+ public:
+
+    typedef uint32_t result_type;
+
+    Draws(Random& random, bool mirror = false):
+        random_(&random),
+        stream_(0),
+        mirror_(mirror) {}
+
+    Draws(uint64_t key, bool mirror = false):
+        random_(nullptr),
+        stream_(key),
+        mirror_(mirror) {}
+
+    static constexpr result_type min(void) {
+        return 0;
+    }
+
+    static constexpr result_type max(void) {
+        return 0xFFFFFFFF;
+    }
+
+    result_type operator()(void) {
+        return random_ ? (*random_)() : stream_();
+    }
+
+    /**
+     * Get a uniform random number in [0, 1)
+     */
+    double chance(void) {
+        return boost::uniform_01<>()(*this);
+    }
+
+    /**
+     * Get a random number from the standard normal distribution
+     *
+     * Negated if these draws are mirrored (for antithetic replicates)
+     */
+    double standard_normal(void) {
+        auto value = boost::normal_distribution<>(0, 1)(*this);
+        return mirror_ ? -value : value;
+    }
+
+ private:
+    Random* random_;
+    Stream stream_;
+    bool mirror_;
+};
+
+
+/**
+ * The context of a simulation
+ *
+ * Holds the state that is shared by all the components of a `Model`
+ * (the current time, the parameters and the random number generator).
+ * Each `Model` owns its own context, so several models can be run
+ * concurrently in the one process. Parameters are held by value so that
+ * inputs can be read once and then copied into each model.
+ */
+class Context {
+ public:
+
+    /**
+     * The current time
+     */
+    Time now = 0;
+
+    /**
+     * Parameters of the simulation
+     */
+    Parameters parameters;
+
+    /**
+     * Random number generator for the simulation
+     */
+    Random random;
+
+    /**
+     * Key for common random number streams (see `draws()`)
+     */
+    uint64_t key;
+
+    /**
+     * Is this an antithetic simulation?
+     *
+     * If true, standard normal deviates (used for temporal variation in growth
+     * and random recruitment strengths) are mirrored. A pair of simulations with
+     * the same seed, one with this on and one with it off, then have negatively
+     * correlated noise. Only useful with `parameters.random_common` on, so that
+     * mirrored deviates are drawn for the same fish and year in both.
+     */
+    bool antithetic = false;
+
+    Context(void):
+        key(random()) {}
+
+    /**
+     * Seed the random number generator and common random number streams
+     *
+     * Two contexts with the same seed (and `parameters.random_common` on) will
+     * draw the same numbers for the same fish in the same year
+     */
+    void seed(unsigned int value) {
+        random.seed(value);
+        key = value;
+    }
+
+    /**
+     * Get random numbers for a process
+     *
+     * If `parameters.random_common` is on, numbers come from a stream keyed on
+     * the process, an identifier (e.g. of a fish or region) and the current time,
+     * otherwise they come from `random`.
+     */
+    Draws draws(Process process, uint64_t id) {
+        if (parameters.random_common) return Draws(Stream::key(key, process, id, now), antithetic);
+        else return Draws(random, antithetic);
+    }
+
+    /**
+     * Get a uniform random number in [0, 1)
+     */
+    double chance(void) {
+        return random.chance();
+    }
+
+};  // class Context
@@ -6,7 +6,6 @@
  * Time
  */
 typedef unsigned int Time;
-Time now;
 
 const unsigned int times_per_year = 1;
 
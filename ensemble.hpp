@@ -0,0 +1,657 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include <boost/math/distributions/normal.hpp>
+
+#include "model.hpp"
+#include "pool.hpp"
+#include "summary.hpp"
+
+/**
+ * An ensemble of replicate model runs
+ *
+ * Runs replicates of `Model`, each with a distinct random seed, concurrently
+ * on a `Pool`. All replicates share the one set of parameters (read in once).
+ * The per-year outputs of each replicate (spawning biomass, catches and CPUE) are
+ * written to files in `output/ensemble` that are indexed by a `replicate` column.
+ *
+ * As each replicate finishes its outputs are also added to streaming summaries
+ * (see `Summary`) so that medians and intervals across replicates can be written
+ * without storing the outputs of every replicate.
+ */
+class Ensemble : public Structure<Ensemble> {
+ public:
+
+    /**
+     * Number of replicates to run
+     *
+     * If there is a precision target (`tolerance`) this is the maximum number of replicates
+     */
+    unsigned int replicates = 10;
+
+    /**
+     * Target precision
+     *
+     * If greater than zero, replicates are launched until the half-width of the
+     * confidence interval (of width `interval`) for the mean of the `precision_output`
+     * is less than this proportion of the mean, or until the budget (`replicates` and
+     * `budget`) is exhausted.
+     */
+    double tolerance = 0;
+
+    /**
+     * Output that the precision target applies to
+     *
+     * s = spawning biomass relative to B0 in the final year
+     * r = spawning biomass relative to B0 in the final year, for every region
+     * l = proportions at length of the catch in the last year with length sampling,
+     *     for every length bin with a mean proportion of at least 1%
+     */
+    char precision_output = 's';
+
+    /**
+     * Minimum number of replicates before the precision target is checked
+     */
+    unsigned int replicates_min = 10;
+
+    /**
+     * Maximum time (seconds) to spend launching replicates when there is
+     * a precision target (0 = no limit)
+     */
+    double budget = 0;
+
+    /**
+     * Number of threads to use (0 = number of cores)
+     */
+    unsigned int threads = 0;
+
+    /**
+     * Base random seed; replicate `r` is seeded with `seed + r`
+     * (or `seed + r/2` for antithetic pairs)
+     */
+    unsigned int seed = std::time(0);
+
+    /**
+     * Run replicates in antithetic pairs?
+     *
+     * If true, replicates `2p` and `2p+1` share a seed with the standard normal
+     * deviates for recruitment strengths and temporal growth variation being
+     * mirrored in the second of the pair (see `Context::antithetic`). The
+     * variance reduction achieved is reported in `summary/antithetic.tsv`.
+     * Turns on common random numbers (`random_common`) for all replicates: with
+     * the sequential generator, draws in the two replicates of a pair go out of
+     * step as soon as their populations differ so mirrored deviates would no longer
+     * apply to the same events.
+     */
+    bool antithetic = false;
+
+    /**
+     * Time period for each replicate
+     */
+    Time start = 1900;
+    Time finish = 2018;
+
+    /**
+     * Write the outputs of each replicate?
+     *
+     * For large ensembles it may be preferable to only write summaries.
+     */
+    bool replicate_outputs = true;
+
+    /**
+     * Width of the interval reported in summaries
+     */
+    double interval = 0.95;
+
+    /**
+     * Directory for ensemble output files
+     */
+    std::string directory = "output/ensemble";
+
+    /**
+     * Print a line to standard output as each replicate finishes?
+     */
+    bool progress = false;
+
+    /**
+     * Initialise the ensemble
+     *
+     * Settings can be overidden in `input/ensemble.json`
+     */
+    void initialise(void) {
+        if (boost::filesystem::exists("input/ensemble.json")) read("input/ensemble.json");
+    }
+
+    /**
+     * Run the ensemble
+     *
+     * @param parameters Parameters shared by all replicates
+     */
+    void run(const Parameters& parameters) {
+        // Antithetic replicates must come in pairs
+        if (antithetic and replicates % 2) replicates++;
+
+        open(parameters.output_compression);
+        summaries_.reset(new Summaries);
+        precision_.reset(new Precision);
+        launched_ = 0;
+        completed_ = 0;
+        precise_ = false;
+        began_ = std::chrono::steady_clock::now();
+
+        Pool pool(threads);
+        pool_ = &pool;
+        parameters_ = parameters;
+        if (antithetic) parameters_.random_common = true;
+        {
+            // If there is a precision target only launch enough replicates to keep the
+            // pool busy (more are launched as each one finishes), otherwise launch them all
+            std::lock_guard<std::mutex> lock(mutex_);
+            unsigned int initial = (tolerance > 0) ? pool.size() : replicates;
+            while (launched_ < initial and launched_ < replicates) launch();
+        }
+        pool.wait();
+        pool_ = nullptr;
+
+        close();
+        summarise(parameters);
+        if (tolerance > 0) report(parameters);
+    }
+
+    template<class Mirror>
+    void reflect(Mirror& mirror){
+        mirror
+            .data(replicates, "replicates")
+            .data(tolerance, "tolerance")
+            .data(precision_output, "precision_output")
+            .data(replicates_min, "replicates_min")
+            .data(budget, "budget")
+            .data(threads, "threads")
+            .data(seed, "seed")
+            .data(antithetic, "antithetic")
+            .data(replicate_outputs, "replicate_outputs")
+            .data(interval, "interval")
+            .data(progress, "progress")
+        ;
+    }
+
+ private:
+
+    /**
+     * Summaries of outputs across replicates
+     *
+     * Age and length samples are only summarised for years in which
+     * they are part of the monitoring programme.
+     */
+    struct Summaries {
+        Array<Summary, Years, Regions> biomass;
+        Array<Summary, Years, Regions, Methods> catches;
+        Array<Summary, Years, Regions, Methods> cpues;
+        Array<Summary, Years, Regions, Methods, Ages> age_samples;
+        Array<Summary, Years, Regions, Methods, Lengths> length_samples;
+
+        // Moments of the means of antithetic pairs
+        Array<Moments, Years, Regions> biomass_pairs;
+        Array<Moments, Years, Regions, Methods> catches_pairs;
+        Array<Moments, Years, Regions, Methods> cpues_pairs;
+
+        // Moments of the replicates in completed antithetic pairs
+        Array<Moments, Years, Regions> biomass_paired;
+        Array<Moments, Years, Regions, Methods> catches_paired;
+        Array<Moments, Years, Regions, Methods> cpues_paired;
+    };
+    std::unique_ptr<Summaries> summaries_;
+
+    /**
+     * Outputs of the first finished replicate of each antithetic
+     * pair, held until the other replicate of the pair finishes
+     */
+    struct Outputs {
+        Array<double, Years, Regions> biomass;
+        Array<double, Years, Regions, Methods> catches;
+        Array<double, Years, Regions, Methods> cpues;
+    };
+    std::map<unsigned int, std::unique_ptr<Outputs>> unpaired_;
+
+    /**
+     * Moments of the outputs that precision targets apply to
+     */
+    struct Precision {
+        Moments status;
+        Array<Moments, Regions> status_regions;
+        Array<Moments, Lengths> catch_lengths;
+    };
+    std::unique_ptr<Precision> precision_;
+
+    Pool* pool_ = nullptr;
+
+    /**
+     * Parameters for replicates (those passed to `run()` with any changes
+     * needed for the ensemble's settings)
+     */
+    Parameters parameters_;
+    std::chrono::steady_clock::time_point began_;
+    unsigned int launched_ = 0;
+    unsigned int completed_ = 0;
+    bool precise_ = false;
+
+    /**
+     * Launch a replicate (or an antithetic pair of replicates)
+     *
+     * Must be called while holding a lock on `mutex_`
+     */
+    void launch(void) {
+        for (unsigned int count = 0; count < (antithetic ? 2 : 1); count++) {
+            if (launched_ >= replicates) return;
+            auto replicate = launched_++;
+            pool_->submit([this, replicate](){
+                auto began = std::chrono::steady_clock::now();
+
+                std::unique_ptr<Model> model(new Model);
+                model->context.seed(replicate_seed(replicate));
+                model->context.antithetic = antithetic and (replicate % 2);
+                model->initialise(parameters_);
+                model->run(start, finish);
+
+                std::chrono::duration<double> duration = std::chrono::steady_clock::now() - began;
+                record(replicate, *model, duration.count());
+            });
+        }
+    }
+
+    std::mutex mutex_;
+    Output replicates_file_;
+    Output biomass_file_;
+    Output catch_file_;
+    Output cpue_file_;
+
+    void open(char compression) {
+        boost::filesystem::create_directories(directory);
+        if (not replicate_outputs) return;
+
+        replicates_file_.open(directory + "/replicates.tsv", compression);
+        replicates_file_ << "replicate\tseed\tantithetic\tseconds\n";
+
+        biomass_file_.open(directory + "/biomass.tsv", compression);
+        biomass_file_ << "replicate\tyear\tregion\tbiomass\n";
+
+        catch_file_.open(directory + "/catch.tsv", compression);
+        catch_file_ << "replicate\tyear\tregion\tmethod\tcatch\n";
+
+        cpue_file_.open(directory + "/cpue.tsv", compression);
+        cpue_file_ << "replicate\tyear\tregion\tmethod\tcpue\n";
+    }
+
+    void close(void) {
+        replicates_file_.close();
+        biomass_file_.close();
+        catch_file_.close();
+        cpue_file_.close();
+    }
+
+    /**
+     * Record the outputs of a replicate
+     *
+     * Called from worker threads so the rows for each replicate are
+     * written, and summaries updated, while holding a lock.
+     */
+    void record(unsigned int replicate, const Model& model, double seconds) {
+        const auto& monitor = model.monitor;
+        const auto& parameters = model.context.parameters;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        accumulate(model);
+        accumulate_precision(model);
+        if (antithetic) pair(replicate, model);
+        completed_++;
+
+        // If there is a precision target and it has not been met, launch another
+        // replicate unless the budget has been exhausted
+        if (tolerance > 0 and not precise_) {
+            precise_ = precise();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - began_;
+            bool exhausted = (budget > 0 and elapsed.count() > budget);
+            if (not precise_ and not exhausted) launch();
+        }
+
+        if (progress) std::cout << "replicate " << replicate << " finished in " << seconds << "s" << std::endl;
+
+        if (not replicate_outputs) return;
+
+        replicates_file_
+            << replicate << "\t"
+            << replicate_seed(replicate) << "\t"
+            << model.context.antithetic << "\t"
+            << seconds << "\n";
+
+        for (auto year : years) {
+            if (year < start or year > finish) continue;
+            auto components = parameters.monitoring_programme(year);
+            for (auto region : regions) {
+                biomass_file_
+                    << replicate << "\t"
+                    << year << "\t"
+                    << region_code(region) << "\t"
+                    << monitor.biomass_spawners(year, region) << "\n";
+
+                for (auto method : methods) {
+                    catch_file_
+                        << replicate << "\t"
+                        << year << "\t"
+                        << region_code(region) << "\t"
+                        << method_code(method) << "\t"
+                        << monitor.catches(year, region, method) << "\n";
+
+                    if (components.C) {
+                        cpue_file_
+                            << replicate << "\t"
+                            << year << "\t"
+                            << region_code(region) << "\t"
+                            << method_code(method) << "\t"
+                            << monitor.cpues(year, region, method) << "\n";
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Get the seed for a replicate
+     */
+    unsigned int replicate_seed(unsigned int replicate) const {
+        return seed + (antithetic ? replicate/2 : replicate);
+    }
+
+    /**
+     * Add the outputs of a replicate to the summaries
+     */
+    void accumulate(const Model& model) {
+        const auto& monitor = model.monitor;
+        const auto& parameters = model.context.parameters;
+        auto& summaries = *summaries_;
+
+        for (auto year : years) {
+            if (year < start or year > finish) continue;
+            auto components = parameters.monitoring_programme(year);
+            for (auto region : regions) {
+                summaries.biomass(year, region).append(monitor.biomass_spawners(year, region));
+                for (auto method : methods) {
+                    summaries.catches(year, region, method).append(monitor.catches(year, region, method));
+                    if (components.C) {
+                        summaries.cpues(year, region, method).append(monitor.cpues(year, region, method));
+                    }
+                    if (components.A) {
+                        for (auto age : ages) {
+                            summaries.age_samples(year, region, method, age).append(monitor.age_samples(year, region, method, age));
+                        }
+                    }
+                    if (components.L) {
+                        for (auto length : lengths) {
+                            summaries.length_samples(year, region, method, length).append(monitor.length_samples(year, region, method, length));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Add the outputs of a replicate to the moments used for precision targets
+     */
+    void accumulate_precision(const Model& model) {
+        const auto& monitor = model.monitor;
+        const auto& parameters = model.context.parameters;
+        auto& precision = *precision_;
+
+        auto last = std::min<unsigned int>(finish, Years_max);
+
+        double status = 0;
+        for (auto region : regions) {
+            precision.status_regions(region).append(monitor.biomass_spawners(last, region)/parameters.fishes_b0(region));
+            status += monitor.biomass_spawners(last, region);
+        }
+        precision.status.append(status/sum(parameters.fishes_b0));
+
+        for (unsigned int year = last; year >= std::max<unsigned int>(start, Years_min); year--) {
+            if (parameters.monitoring_programme(year).L) {
+                Array<double, Lengths> catch_lengths = 0;
+                for (auto region : regions) {
+                    for (auto method : methods) {
+                        for (auto length : lengths) {
+                            catch_lengths(length) += monitor.length_samples(year, region, method, length);
+                        }
+                    }
+                }
+                auto total = sum(catch_lengths);
+                if (total > 0) {
+                    for (auto length : lengths) {
+                        precision.catch_lengths(length).append(catch_lengths(length)/total);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    /**
+     * Get the relative half-width of the confidence interval for
+     * the mean of some moments
+     */
+    double precision_of(const Moments& moments) const {
+        if (moments.count() < 2 or moments.mean() == 0) return std::numeric_limits<double>::infinity();
+        auto z = boost::math::quantile(boost::math::normal(), (1 + interval)/2);
+        return z * moments.se()/std::fabs(moments.mean());
+    }
+
+    /**
+     * Get the precision achieved for the `precision_output`
+     *
+     * For outputs with several values (e.g. regions) the worst precision is returned.
+     */
+    double precision(void) const {
+        const auto& precision = *precision_;
+        switch (precision_output) {
+            case 's':
+                return precision_of(precision.status);
+            case 'r': {
+                double worst = 0;
+                for (const auto& moments : precision.status_regions) worst = std::max(worst, precision_of(moments));
+                return worst;
+            }
+            case 'l': {
+                double worst = 0;
+                bool any = false;
+                for (const auto& moments : precision.catch_lengths) {
+                    if (moments.mean() >= 0.01) {
+                        worst = std::max(worst, precision_of(moments));
+                        any = true;
+                    }
+                }
+                return any ? worst : std::numeric_limits<double>::infinity();
+            }
+            default:
+                throw std::runtime_error(std::string("Unknown precision output: ") + precision_output);
+        }
+    }
+
+    /**
+     * Has the precision target been met?
+     */
+    bool precise(void) const {
+        return completed_ >= replicates_min and precision() <= tolerance;
+    }
+
+    /**
+     * Report on the replicates needed to meet the precision target
+     */
+    void report(const Parameters& parameters) {
+        Output file(directory + "/summary/precision.tsv", parameters.output_compression);
+        file << "name\tvalue\n"
+             << "precision_output\t" << precision_output << "\n"
+             << "tolerance\t" << tolerance << "\n"
+             << "precision\t" << precision() << "\n"
+             << "achieved\t" << precise_ << "\n"
+             << "replicates\t" << completed_ << "\n";
+
+        if (precise_) std::cout << "Precision target achieved";
+        else std::cout << "Budget exhausted before precision target achieved";
+        std::cout << " after " << completed_ << " replicates (precision " << precision() << ")" << std::endl;
+    }
+
+    /**
+     * Pair the outputs of antithetic replicates
+     *
+     * Holds the outputs of the first replicate of a pair to finish and,
+     * when the second finishes, adds the means of the pair, and each of
+     * its replicates, to the summaries. Replicates of incomplete pairs are
+     * therefore not included in the variance reduction.
+     */
+    void pair(unsigned int replicate, const Model& model) {
+        const auto& monitor = model.monitor;
+        const auto& parameters = model.context.parameters;
+        auto& summaries = *summaries_;
+
+        auto index = replicate/2;
+        auto iter = unpaired_.find(index);
+        if (iter == unpaired_.end()) {
+            std::unique_ptr<Outputs> outputs(new Outputs);
+            outputs->biomass = monitor.biomass_spawners;
+            outputs->catches = monitor.catches;
+            outputs->cpues = monitor.cpues;
+            unpaired_[index] = std::move(outputs);
+            return;
+        }
+        const auto& other = *iter->second;
+
+        for (auto year : years) {
+            if (year < start or year > finish) continue;
+            auto components = parameters.monitoring_programme(year);
+            for (auto region : regions) {
+                auto biomass = monitor.biomass_spawners(year, region);
+                summaries.biomass_pairs(year, region).append((biomass + other.biomass(year, region))/2);
+                summaries.biomass_paired(year, region).append(biomass);
+                summaries.biomass_paired(year, region).append(other.biomass(year, region));
+                for (auto method : methods) {
+                    auto catches = monitor.catches(year, region, method);
+                    summaries.catches_pairs(year, region, method).append((catches + other.catches(year, region, method))/2);
+                    summaries.catches_paired(year, region, method).append(catches);
+                    summaries.catches_paired(year, region, method).append(other.catches(year, region, method));
+                    if (components.C) {
+                        auto cpues = monitor.cpues(year, region, method);
+                        summaries.cpues_pairs(year, region, method).append((cpues + other.cpues(year, region, method))/2);
+                        summaries.cpues_paired(year, region, method).append(cpues);
+                        summaries.cpues_paired(year, region, method).append(other.cpues(year, region, method));
+                    }
+                }
+            }
+        }
+
+        unpaired_.erase(iter);
+    }
+
+    /**
+     * Write the variance reduction achieved by antithetic pairs
+     *
+     * The reduction is relative to the variance of the mean of the same number
+     * of independent replicates i.e. `1 - var(pair means)/(var(replicates)/2)`.
+     * A value of 0.5 means that half as many antithetic replicates
+     * are needed as independent replicates. Both variances are of
+     * completed pairs only.
+     */
+    void write_antithetic(std::ostream& stream, const std::string& output, unsigned int year, std::string region, std::string method,
+                          const Moments& replicates, const Moments& pairs) {
+        stream << output << "\t" << year << "\t" << region << "\t" << method << "\t" << pairs.count() << "\t";
+        auto variance = replicates.variance();
+        if (variance > 0) stream << 1 - pairs.variance()/(variance/2);
+        else stream << "NA";
+        stream << "\n";
+    }
+
+    /**
+     * Write summaries to files in `<directory>/summary`
+     */
+    void summarise(const Parameters& parameters) {
+        auto& summaries = *summaries_;
+        auto summary_directory = directory + "/summary";
+        boost::filesystem::create_directories(summary_directory);
+        auto compression = parameters.output_compression;
+
+        Output biomass_file(summary_directory + "/biomass.tsv", compression);
+        biomass_file << "year\tregion\t" << Summary::header() << "\n";
+
+        Output catch_file(summary_directory + "/catch.tsv", compression);
+        catch_file << "year\tregion\tmethod\t" << Summary::header() << "\n";
+
+        Output cpue_file(summary_directory + "/cpue.tsv", compression);
+        cpue_file << "year\tregion\tmethod\t" << Summary::header() << "\n";
+
+        Output age_file(summary_directory + "/age.tsv", compression);
+        age_file << "year\tregion\tmethod\tage\t" << Summary::header() << "\n";
+
+        Output length_file(summary_directory + "/length.tsv", compression);
+        length_file << "year\tregion\tmethod\tlength\t" << Summary::header() << "\n";
+
+        Output antithetic_file;
+        if (antithetic) {
+            antithetic_file.open(summary_directory + "/antithetic.tsv", compression);
+            antithetic_file << "output\tyear\tregion\tmethod\tpairs\treduction\n";
+        }
+
+        for (auto year : years) {
+            if (year < start or year > finish) continue;
+            auto components = parameters.monitoring_programme(year);
+            for (auto region : regions) {
+                biomass_file << year << "\t" << region_code(region) << "\t";
+                summaries.biomass(year, region).write(biomass_file, interval);
+                biomass_file << "\n";
+
+                if (antithetic) {
+                    write_antithetic(antithetic_file, "biomass", year, region_code(region), "NA",
+                        summaries.biomass_paired(year, region), summaries.biomass_pairs(year, region));
+                }
+
+                for (auto method : methods) {
+                    catch_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
+                    summaries.catches(year, region, method).write(catch_file, interval);
+                    catch_file << "\n";
+
+                    if (antithetic) {
+                        write_antithetic(antithetic_file, "catch", year, region_code(region), method_code(method),
+                            summaries.catches_paired(year, region, method), summaries.catches_pairs(year, region, method));
+                    }
+
+                    if (components.C) {
+                        cpue_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
+                        summaries.cpues(year, region, method).write(cpue_file, interval);
+                        cpue_file << "\n";
+
+                        if (antithetic) {
+                            write_antithetic(antithetic_file, "cpue", year, region_code(region), method_code(method),
+                                summaries.cpues_paired(year, region, method), summaries.cpues_pairs(year, region, method));
+                        }
+                    }
+
+                    if (components.A) {
+                        for (auto age : ages) {
+                            age_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t" << age << "\t";
+                            summaries.age_samples(year, region, method, age).write(age_file, interval);
+                            age_file << "\n";
+                        }
+                    }
+
+                    if (components.L) {
+                        for (auto length : lengths) {
+                            length_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t" << length << "\t";
+                            summaries.length_samples(year, region, method, length).write(length_file, interval);
+                            length_file << "\n";
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+};  // class Ensemble
@@ -2,14 +2,28 @@
 
 #include "requirements.hpp"
 #include "dimensions.hpp"
-#include "parameters.hpp"
+#include "context.hpp"
 #include "environ.hpp"
+#include "blocks.hpp"
+#include "columnar.hpp"
+#include "tsv.hpp"
+#include "writer.hpp"
 
 /**
  * A fish
  */
 class Fish {
  public:
+    /**
+     * Identity of this fish
+     *
+     * Derived from when and where the fish was born so that, when using
+     * common random numbers, the "same" fish in different simulations
+     * draws the same random numbers. Holds the full 64-bit key from
+     * `Stream::key()` so that identities are not truncated.
+     */
+    uint64_t id;
+
     /**
      * Home region for this fish
      */
@@ -66,6 +80,14 @@ class Fish {
      */
     short method_last;
 
+    /**
+     * Number of individuals that this instance represents (relative
+     * to `Fishes::scalar`)
+     *
+     * Greater than 1 for super-individuals (see `fishes_recruit_count`)
+     */
+    unsigned int count;
+
 
     /*************************************************************
      * Attributes
@@ -81,15 +103,15 @@ class Fish {
     /**
      * Get the age of this fish
      */
-    float age(void) const {
-        return year(now)-year(birth);
+    float age(const Context& context) const {
+        return year(context.now)-year(birth);
     }
 
     /**
      * Get the age bin of this fish
      */
-    int age_bin(void) const {
-        return ::age_bin(age());
+    int age_bin(const Context& context) const {
+        return ::age_bin(age(context));
     }
 
     /**
@@ -105,8 +127,8 @@ class Fish {
      * Currently, all fish have the same condition factor so weight is
      * simply a function of length
      */
-    double weight(void) const {
-        return parameters.fishes_a*std::pow(length, parameters.fishes_b);
+    double weight(const Context& context) const {
+        return context.parameters.fishes_a*std::pow(length, context.parameters.fishes_b);
     }
 
     /*************************************************************
@@ -123,25 +145,34 @@ class Fish {
      *  - exponential distribution of ages
      *  - seed fish are distributed evenly across areas
      *  - maturity is approximated by maturation schedule
+     *
+     * @param index Index of the fish in the seed population
      */
-    void seed(void) {
-        home = Region(int(parameters.fishes_seed_region_dist.random()));
+    void seed(Context& context, unsigned int index = 0) {
+        auto& parameters = context.parameters;
+
+        id = Stream::key(index);
+        auto draws = context.draws(process_birth, id);
+
+        home = Region(int(parameters.fishes_seed_region_dist.random(draws)));
         region = home;
 
-        auto age = std::max(1.,std::min(parameters.fishes_seed_age_dist.random(),100.));
-        birth = now-age;
+        auto age = std::max(1.,std::min(parameters.fishes_seed_age_dist.random(draws),100.));
+        birth = context.now-age;
         death = 0;
 
-        sex = (chance()<parameters.fishes_males)?male:female;
+        sex = (draws.chance()<parameters.fishes_males)?male:female;
 
-        growth_init(age);
+        growth_init(context, draws, age);
 
         // This an approximation
-        mature = chance()<parameters.fishes_maturation(age);
+        mature = draws.chance()<parameters.fishes_maturation(age);
 
         tag = 0;
 
         method_last = -1;
+
+        count = 1;
     }
 
     /**
@@ -149,23 +180,30 @@ class Fish {
      *
      * Initialises attributes as though this fish is close
      * to age 0
+     *
+     * @param index Index of the fish amongst those born in the region at this time
      */
-    void born(Region region_) {
+    void born(Context& context, Region region_, unsigned int index = 0) {
+        id = Stream::key(context.now, region_ + 1, index);
+        auto draws = context.draws(process_birth, id);
+
         home = region_;
         region = home;
 
-        birth = now;
+        birth = context.now;
         death = 0;
         
-        sex = (chance()<parameters.fishes_males)?male:female;
+        sex = (draws.chance()<context.parameters.fishes_males)?male:female;
 
-        growth_init(0);
+        growth_init(context, draws, 0);
 
         mature = false;
 
         tag = 0;
 
         method_last = -1;
+
+        count = std::max(context.parameters.fishes_recruit_count, 1u);
     }
 
     /**
@@ -174,7 +212,8 @@ class Fish {
      * Note that event if this is an exponential growth model that
      * we are parameterize if using `k` and `linf`
      */
-    void growth_init(int age) {
+    void growth_init(Context& context, Draws& draws, int age) {
+        auto& parameters = context.parameters;
         // Get von Bert growth parameters from their distributions
         double k;
         double linf;
@@ -185,8 +224,8 @@ class Fish {
             linf = parameters.fishes_linf_mean;
         } else {
             // Each individual fish gets it's own growth parameters
-            k = parameters.fishes_k_dist.random();
-            linf = parameters.fishes_linf_dist.random();
+            k = parameters.fishes_k_dist.random(draws);
+            linf = parameters.fishes_linf_dist.random(draws);
         }
         // Convert `k` and `linf` to `growth_intercept` and `growth_slope`
         growth_slope = std::exp(-k)-1;
@@ -204,24 +243,74 @@ class Fish {
      * is also used by `Fleets` to kill a fish from harvest or
      * incidental mortality
      */
-    void dies(void) {
-        death = now;
+    void dies(const Context& context) {
+        death = context.now;
     }
 
     /**
-     * Does this fish survive this time step?
+     * Remove one individual from this instance (e.g. because it was caught)
+     *
+     * Kills this fish if it is not a super-individual
      */
-    bool survival(void) {
-        auto survives = chance() > parameters.fishes_m_rate;
-        if (not survives) dies();
+    void decrement(const Context& context) {
+        if (count > 1) count--;
+        else dies(context);
+    }
+
+    /**
+     * When choosing instances at random, is this one picked?
+     *
+     * Super-individuals are picked in proportion to their count so that each
+     * individual has the same chance of being chosen. Always true (and no
+     * random number is drawn) if super-individuals are not being used.
+     */
+    bool picked(Context& context) const {
+        auto maximum = context.parameters.fishes_recruit_count;
+        if (maximum <= 1) return true;
+        return context.chance() < double(count)/maximum;
+    }
+
+    /**
+     * Does this fish survive this time step?
+     *
+     * For a super-individual, each of the individuals it represents dies independently
+     * and this fish only dies if all of them do.
+     */
+    bool survival(Context& context) {
+        auto draws = context.draws(process_survival, id);
+        if (count > 1) {
+            count -= boost::random::binomial_distribution<int>(count, context.parameters.fishes_m_rate)(draws);
+            if (count == 0) dies(context);
+            return count > 0;
+        }
+        auto survives = draws.chance() > context.parameters.fishes_m_rate;
+        if (not survives) dies(context);
         return survives;
     }
 
     /**
      * Increase the length of this fish
      */
-    void growth(void) {
+    void growth(Context& context) {
+        auto& parameters = context.parameters;
         // Calculate growth increment
+        double incr = growth_increment(parameters);
+        // Apply temporal variation in growth if needed
+        if (parameters.fishes_growth_variation == 't' or parameters.fishes_growth_variation == 'm') {
+            int sd = std::max(parameters.fishes_growth_temporal_sdmin, incr * parameters.fishes_growth_temporal_cv);
+            incr += context.draws(process_growth, id).standard_normal() * sd;
+            if (incr < parameters.fishes_growth_temporal_incrmin) incr = parameters.fishes_growth_temporal_incrmin;
+        }
+        // Add increment but ensure fish size does not go below zero
+        length += incr;
+        if (length < 0) length = 0;
+    }
+
+    /**
+     * Expected growth increment of this fish at its current length
+     * (i.e. without temporal variation)
+     */
+    double growth_increment(const Parameters& parameters) const {
         double incr;
         if (parameters.fishes_growth_model == 'l') {
             // Linear increment v length
@@ -238,23 +327,15 @@ class Fish {
         } else {
             throw std::runtime_error("Unknown growth model: " + parameters.fishes_growth_model);
         }
-        // Apply temporal variation in growth if needed
-        if (parameters.fishes_growth_variation == 't' or parameters.fishes_growth_variation == 'm') {
-            int sd = std::max(parameters.fishes_growth_temporal_sdmin, incr * parameters.fishes_growth_temporal_cv);
-            incr += standard_normal_rand() * sd;
-            if (incr < parameters.fishes_growth_temporal_incrmin) incr = parameters.fishes_growth_temporal_incrmin;
-        }
-        // Add increment but ensure fish size does not go below zero
-        length += incr;
-        if (length < 0) length = 0;
+        return incr;
     }
 
     /**
      * Change the maturation status of this fish
      */
-    void maturation(void) {
+    void maturation(Context& context) {
         if (not mature) {
-            if (chance()<parameters.fishes_maturation(age_bin())) {
+            if (context.draws(process_maturation, id).chance()<context.parameters.fishes_maturation(age_bin(context))) {
                 mature = true;
             }
         }
@@ -263,7 +344,8 @@ class Fish {
     /**
      * Move this fish
      */
-    void movement(void) {
+    void movement(Context& context) {
+        auto& parameters = context.parameters;
         // If no movement, don't do anything
         if (parameters.fishes_movement_type == 'n') return;
         // Instantaneous movement between regions is eith Markovian (based on where fish is)
@@ -278,8 +360,9 @@ class Fish {
             break; 
         };
         // Randomly move a region (note that rows of the movement matrix sum to 1)
-        auto region_to = Region(regions.select(chance()).index());
-        if (chance() < parameters.fishes_movement(basis, region_to)) {
+        auto draws = context.draws(process_movement, id);
+        auto region_to = Region(regions.select(draws.chance()).index());
+        if (draws.chance() < parameters.fishes_movement(basis, region_to)) {
             region = region_to;
         }
     }
@@ -294,9 +377,9 @@ class Fish {
     /**
      * Does this fish shed it's tag (if any)?
      */
-    void shedding(void) {
+    void shedding(Context& context) {
         if (tag) {
-            if (chance() < parameters.tagging_shedding) {
+            if (context.draws(process_shedding, id).chance() < context.parameters.tagging_shedding) {
                 tag = 0;
             }
         }
@@ -309,14 +392,14 @@ class Fish {
  * The population of `Fish`
  * 
  * We don't attempt to model every single fish in the population. Instead,
- * the vector of `Fish` objects is intended to be a representative sample of the overall population.
+ * the `Fish` objects (stored in `Blocks`) are intended to be a representative sample of the overall population.
  * The variable, `scalar` is then used to scale other variables, like biomass, to population levels.
  */
-class Fishes : public std::vector<Fish> {
+class Fishes : public Blocks<Fish> {
  public:
 
     Fishes(int size = 0):
-        std::vector<Fish>(size){}
+        Blocks<Fish>(size){}
 
     /**
      * Population scalar
@@ -333,12 +416,178 @@ class Fishes : public std::vector<Fish> {
      * This method is usually used in `Model::pristine` to reduce burn-in times
      * but is a separate method so that it can also be used in unit tests. 
      */
-    void seed(unsigned int number) {
+    void seed(Context& context, unsigned int number) {
         clear();
         resize(number);
+        unsigned int index = 0;
         for (auto& fish : *this) {
-            fish.seed();
+            fish.seed(context, index++);
+        }
+    }
+
+    /**
+     * Choose a fish at random (e.g. for harvesting)
+     *
+     * If `harvest_sampling_batch` is not zero then that many fish are chosen from
+     * one block before choosing another block (see `Parameters::harvest_sampling_batch`).
+     *
+     * @return Index of the fish
+     */
+    unsigned int choose(Context& context) {
+        auto batch = context.parameters.harvest_sampling_batch;
+        if (batch == 0) return context.chance() * size();
+        if (chosen_ == 0 or chosen_ >= batch or chosen_block_ >= blocks()) {
+            // Choose a block in proportion to its size by choosing a fish
+            chosen_block_ = (unsigned int)(context.chance() * size()) / block_size;
+            chosen_ = 0;
+        }
+        chosen_++;
+        return chosen_block_ * block_size + context.chance() * block(chosen_block_).size();
+    }
+
+    /**
+     * Make the instance at an index represent a single individual
+     *
+     * If it is a super-individual, the other individuals it represents are split off
+     * into a new instance (e.g. so that one of them can be tagged). References to
+     * fish remain valid because fish are stored in `Blocks`.
+     *
+     * @return The instance at the index
+     */
+    Fish& single(unsigned int index) {
+        Fish& fish = (*this)[index];
+        if (fish.count > 1) {
+            Fish rest = fish;
+            rest.id = Stream::key(fish.id, fish.count);
+            rest.count = fish.count - 1;
+            fish.count = 1;
+            push_back(rest);
+        }
+        return (*this)[index];
+    }
+
+    /**
+     * Split super-individuals that have reached `fishes_split_age`
+     * into single individuals
+     */
+    void split(const Context& context) {
+        auto age = context.parameters.fishes_split_age;
+        if (context.parameters.fishes_recruit_count <= 1 or age == 0) return;
+
+        unsigned int slot = 0;
+        auto number = size();
+        for (unsigned int index = 0; index < number; index++) {
+            if (not (*this)[index].alive() or (*this)[index].count <= 1) continue;
+            if ((*this)[index].age(context) < int(age)) continue;
+
+            Fish single = (*this)[index];
+            single.count = 1;
+            for (unsigned int part = 1; part < (*this)[index].count; part++) {
+                single.id = Stream::key((*this)[index].id, part);
+                // Put into an empty slot or at the end of the population
+                while (slot < size() and (*this)[slot].alive()) slot++;
+                if (slot < size()) (*this)[slot] = single;
+                else push_back(single);
+            }
+            (*this)[index].count = 1;
+        }
+    }
+
+    /**
+     * A change in `scalar` from thinning or upsampling the population
+     */
+    struct Rescale {
+        Time time;
+        unsigned int instances_before;
+        unsigned int instances_after;
+        double scalar_before;
+        double scalar_after;
+    };
+
+    /**
+     * Log of rescale events (written to `output/fishes/rescales.tsv`)
+     */
+    std::vector<Rescale> rescales;
+
+    /**
+     * Keep the number of live instances within `fishes_instances_min`
+     * and `fishes_instances_max`
+     *
+     * If outside those limits, the population is thinned (by randomly retaining instances),
+     * or upsampled (by cloning instances), back to `fishes_seed_number` live instances.
+     * Tagged fish are always retained and are never cloned. `scalar` is adjusted so that the
+     * total number of fish represented is unchanged. After thinning, dead instances are
+     * removed so that memory use is bounded.
+     */
+    void rescale(Context& context) {
+        const auto& parameters = context.parameters;
+        auto maximum = parameters.fishes_instances_max;
+        auto minimum = parameters.fishes_instances_min;
+        if (maximum == 0 and minimum == 0) return;
+
+        unsigned int instances = 0;
+        unsigned int tagged = 0;
+        double individuals = 0;
+        for (const auto& fish : *this) {
+            if (fish.alive()) {
+                instances++;
+                if (fish.tag) tagged++;
+                individuals += fish.count;
+            }
         }
+        bool thin = maximum > 0 and instances > maximum;
+        bool upsample = minimum > 0 and instances < minimum and instances > tagged;
+        if (not thin and not upsample) return;
+
+        // Ratio of the wanted number of untagged instances to the current number
+        auto target = parameters.fishes_seed_number;
+        double ratio = (std::max(target, tagged) - tagged)/double(instances - tagged);
+        // Nothing to do if the target is not beyond the limit (e.g. if the limits
+        // were set directly, without the checks in `Parameters::update()`)
+        if ((thin and ratio >= 1) or (upsample and ratio <= 1)) return;
+
+        Rescale event;
+        event.time = context.now;
+        event.instances_before = instances;
+        event.scalar_before = scalar;
+
+        double individuals_after = 0;
+        if (thin) {
+            for (auto& fish : *this) {
+                if (fish.alive() and not fish.tag) {
+                    if (context.draws(process_rescaling, fish.id).chance() >= ratio) fish.dies(context);
+                }
+                if (fish.alive()) individuals_after += fish.count;
+            }
+            erase_if([](const Fish& fish){
+                return not fish.alive();
+            });
+            shrink_to_fit();
+        } else {
+            auto number = size();
+            for (unsigned int index = 0; index < number; index++) {
+                if (not (*this)[index].alive()) continue;
+                individuals_after += (*this)[index].count;
+                if ((*this)[index].tag) continue;
+                // Number of clones so that, on average, each instance is replaced by `ratio` instances
+                auto draws = context.draws(process_rescaling, (*this)[index].id);
+                unsigned int clones = ratio - 1;
+                if (draws.chance() < (ratio - 1) - clones) clones++;
+                for (unsigned int clone = 1; clone <= clones; clone++) {
+                    Fish copy = (*this)[index];
+                    copy.id = Stream::key(copy.id, context.now, clone);
+                    push_back(copy);
+                    individuals_after += copy.count;
+                }
+            }
+        }
+
+        scalar *= individuals/individuals_after;
+
+        event.instances_after = 0;
+        for (const auto& fish : *this) if (fish.alive()) event.instances_after++;
+        event.scalar_after = scalar;
+        rescales.push_back(event);
     }
 
     /**
@@ -350,11 +599,11 @@ class Fishes : public std::vector<Fish> {
      */
     double biomass;
 
-    void biomass_update(void) {
+    void biomass_update(const Context& context) {
         biomass = 0.0;
         for (auto& fish : *this) {
             if (fish.alive()) {
-                biomass += fish.weight();
+                biomass += fish.weight(context) * fish.count;
             }
         }
         biomass *= scalar;
@@ -365,11 +614,11 @@ class Fishes : public std::vector<Fish> {
      */
     Array<double, Regions> biomass_spawners;
 
-    void biomass_spawners_update(void) {
+    void biomass_spawners_update(const Context& context) {
         biomass_spawners = 0.0;
         for (auto& fish : *this) {
             if (fish.alive() and fish.mature) {
-                biomass_spawners(fish.region) += fish.weight();
+                biomass_spawners(fish.region) += fish.weight(context) * fish.count;
             }
         }
         biomass_spawners *= scalar;
@@ -394,8 +643,9 @@ class Fishes : public std::vector<Fish> {
     Array<unsigned int, Regions> recruitment_instances;
 
 
-    void recruitment_update(void) {
-        auto y = year(now);
+    void recruitment_update(Context& context) {
+        auto& parameters = context.parameters;
+        auto y = year(context.now);
         for(auto region : regions) {
             if (recruitment_mode == 'p') {
                 recruitment(region) = recruitment_pristine(region);
@@ -408,13 +658,17 @@ class Fishes : public std::vector<Fish> {
 
                 double strength = parameters.fishes_rec_strengths(y, region);
                 if (strength < 0) {
-                    strength = Lognormal(1, parameters.fishes_rec_var).random();
+                    // Lognormal with a mean of 1 and a c.v. of `fishes_rec_var`. Calculated from a
+                    // standard normal deviate so that it is mirrored in antithetic simulations
+                    auto sigma = std::sqrt(std::log(1 + std::pow(parameters.fishes_rec_var, 2)));
+                    auto deviate = context.draws(process_recruitment, region.index()).standard_normal();
+                    strength = std::exp(-sigma*sigma/2 + sigma*deviate);
                 }
 
                 recruitment(region) = determ * strength;
 
             }
-            recruitment_instances(region) = std::round(recruitment(region)/scalar);
+            recruitment_instances(region) = std::round(recruitment(region)/scalar/std::max(parameters.fishes_recruit_count, 1u));
         }
     }
 
@@ -428,16 +682,20 @@ class Fishes : public std::vector<Fish> {
     /**
      * Initialise parameters etc
      */
-    void initialise(void){
+    void initialise(const Context& context){
+        allocation.pages = context.parameters.fishes_pages;
+        allocation.placement = context.parameters.fishes_placement;
+        allocation.directory = context.parameters.fishes_file;
     }
 
     /**
      * Finalise (e.g. write values to file)
      */
-    void finalise(void){
+    void finalise(Context& context){
         boost::filesystem::create_directories("output/fishes");
+        auto compression = context.parameters.output_compression;
 
-        std::ofstream values("output/fishes/values.tsv");
+        Output values("output/fishes/values.tsv", compression);
         values << "name\tvalue" << std::endl
                << "fishes_size\t" << size() << std::endl
                << "fish_bytes\t" << sizeof(Fish) << std::endl
@@ -445,14 +703,28 @@ class Fishes : public std::vector<Fish> {
                << "scalar\t" << scalar << std::endl
                << "number\t" << number(true) << std::endl;
 
+        Output rescales_file("output/fishes/rescales.tsv", compression);
+        rescales_file << "time\tinstances_before\tinstances_after\tscalar_before\tscalar_after\n";
+        for (const auto& event : rescales) {
+            rescales_file
+                << event.time << "\t"
+                << event.instances_before << "\t"
+                << event.instances_after << "\t"
+                << event.scalar_before << "\t"
+                << event.scalar_after << "\n";
+        }
+
         // Generate some example growth trajectories for checking
-        std::ofstream pars("output/fishes/growth_pars.tsv");
+        // (with common random numbers off so that each time step gets a different deviate)
+        Context sampling = context;
+        sampling.parameters.random_common = false;
+        Output pars("output/fishes/growth_pars.tsv", compression);
         pars << "fish\tintercept\tslope\n";
-        std::ofstream trajs("output/fishes/growth_trajs.tsv");
+        Output trajs("output/fishes/growth_trajs.tsv", compression);
         trajs << "fish\ttime\tlength\tlength_new\n";
         for (int index = 0; index < 100; index++) {
             Fish fish;
-            fish.born(HG);
+            fish.born(sampling, HG, index);
             pars << index << "\t"
                  << fish.growth_intercept << "\t" 
                  << fish.growth_slope << "\n";
@@ -460,7 +732,7 @@ class Fishes : public std::vector<Fish> {
                 trajs << index << "\t"
                      << time << "\t"
                      << fish.length << "\t";
-                fish.growth();
+                fish.growth(sampling);
                 trajs << fish.length << "\n";
             }
         }
@@ -476,7 +748,7 @@ class Fishes : public std::vector<Fish> {
         auto sum = 0.0;
         for (auto fish : *this){
             if (fish.alive()) {
-                sum++;
+                sum += fish.count;
             }
         }
         return sum * (scale?scalar:1);
@@ -485,68 +757,145 @@ class Fishes : public std::vector<Fish> {
     /**
      * Calculate the mean age of fish
      */
-    double age_mean(void) {
-        Mean mean;
+    double age_mean(const Context& context) {
+        double sum = 0;
+        double count = 0;
         for (auto fish : *this) {
-            if (fish.alive()) mean.append(fish.age());
+            if (fish.alive()) {
+                sum += fish.age(context) * fish.count;
+                count += fish.count;
+            }
         }
-        return mean;
+        return sum/count;
     }
 
     /**
      * Calculate the mean length of fish
      */
     double length_mean(void) {
-        Mean mean;
+        double sum = 0;
+        double count = 0;
         for (auto fish : *this) {
-            if (fish.alive()) mean.append(fish.length);
+            if (fish.alive()) {
+                sum += fish.length * fish.count;
+                count += fish.count;
+            }
         }
-        return mean;
+        return sum/count;
     }
 
     /**
      * Enumerate the population (count number of fish etc)
      */
-    void enumerate(void) {
+    void enumerate(const Context& context) {
         counts = 0;
         for (auto fish : *this) {
             if(fish.alive()){
                 counts(
                     fish.region,
                     fish.sex,
-                    fish.age_bin(),
+                    fish.age_bin(context),
                     fish.length_bin()
-                )++;
+                ) += fish.count;
             }
         }
     }
 
     /**
-     * Track the population by writing attributes and structure to files
+     * File that population counts are written to by `track()`
+     *
+     * Shared with any tasks handed to a `Writer` so that they do not
+     * depend on the lifetime of this population.
      */
-    void track(void){ 
-        static std::ofstream* counts_file = nullptr;
-        if(not counts_file) counts_file = new std::ofstream("output/fishes/counts.tsv");
+    std::shared_ptr<Output> counts_file;
+
+    /**
+     * Columnar file that population counts are written to by `track()`
+     * (if `output_format` is `c`)
+     */
+    std::shared_ptr<Columnar> counts_columnar;
+
+    /**
+     * Track the population by writing attributes and structure to files
+     *
+     * Called each year by `Model::update()` if `fishes_track` is true.
+     *
+     * @param writer Background writer to hand off the writing to (if any).
+     *               The task only holds copies of the counts and the files
+     *               so the writer does not need to be drained before this
+     *               population is destroyed.
+     */
+    void track(const Context& context, Writer* writer = nullptr){ 
+        enumerate(context);
+
+        // Files are opened here, rather than by the writer, so that
+        // tasks are independent of `context.parameters`
+        const auto& parameters = context.parameters;
+        if (not counts_file and not counts_columnar) boost::filesystem::create_directories("output/fishes");
+        if (parameters.output_format == 'c') {
+            if (not counts_columnar) counts_columnar.reset(new Columnar("output/fishes/counts.col", {
+                {"time", {}}, columnar_regions(), columnar_sexes(), columnar_ages(), columnar_lengths()
+            }));
+        } else {
+            if (not counts_file) counts_file.reset(new Output("output/fishes/counts.tsv", parameters.output_compression));
+        }
 
-        enumerate();
+        auto now = context.now;
+        auto precision = parameters.output_precision;
+        if (writer) {
+            auto file = parameters.output_format == 'c' ? nullptr : counts_file;
+            auto columnar = parameters.output_format == 'c' ? counts_columnar : nullptr;
+            std::shared_ptr<const decltype(counts)> copy(new decltype(counts)(counts));
+            writer->submit([now, precision, file, columnar, copy](){
+                counts_write(now, precision, file.get(), columnar.get(), *copy);
+            }, sizeof(counts));
+        } else if (parameters.output_format == 'c') {
+            counts_write(now, precision, nullptr, counts_columnar.get(), counts);
+        } else {
+            counts_write(now, precision, counts_file.get(), nullptr, counts);
+        }
+    }
 
+    /**
+     * Write population counts for a time to either a TSV or a columnar file
+     */
+    static void counts_write(Time now, int precision, Output* counts_file, Columnar* counts_columnar, const decltype(counts)& counts){
+        if (counts_columnar) {
+            for (auto region : regions) {
+                for (auto sex : sexes) {
+                    for (auto age : ages) {
+                        for (auto length : lengths) {
+                            counts_columnar->append(
+                                {now, region.index(), sex.index(), age.index(), length.index()},
+                                counts(region, sex, age, length)
+                            );
+                        }
+                    }
+                }
+            }
+            counts_columnar->flush();
+            return;
+        }
+
+        Tsv file(*counts_file, precision);
         for(auto region : regions){
             for(auto sex : sexes){
                 for(auto age: ages){
                     for(auto length : lengths){
-                        (*counts_file)
-                            <<now<<"\t"
-                            <<region<<"\t"
-                            <<sex<<"\t"
-                            <<age<<"\t"
-                            <<length<<"\t"
-                            <<counts(region,sex,age,length)<<"\n"
-                        ;
+                        file.row(now, region, sex, age, length, counts(region,sex,age,length));
                     }
                 }
             }
         }
-        (*counts_file).flush();
+        file.flush();
     }
 
+ private:
+
+    /**
+     * Current block, and number of fish chosen from it, in `choose()`
+     */
+    unsigned int chosen_block_ = 0;
+    unsigned int chosen_ = 0;
+
 };  // end class Fishes
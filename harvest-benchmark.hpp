@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+
+#include "model.hpp"
+
+/**
+ * A benchmark of the harvest phase for differing allocations of the population
+ *
+ * Harvesting (and tag release) chooses fish at random from the whole population so,
+ * with large numbers of instances, its speed is limited by memory access (in particular
+ * TLB misses). This benchmark times `Model::harvesting()` for each combination of
+ * `fishes_pages` and `fishes_placement` in `allocations` with the same seeded population.
+ * Results are written to `output/harvest_benchmark.tsv`.
+ */
+class HarvestBenchmark {
+ public:
+
+    /**
+     * Number of instances of `Fish`
+     */
+    unsigned int instances = 1e7;
+
+    /**
+     * Combinations of `fishes_pages` and `fishes_placement` to time
+     */
+    std::vector<std::string> allocations = {"nf", "tf", "ef", "ni", "ti"};
+
+    /**
+     * Number of times each allocation is timed
+     */
+    unsigned int repeats = 3;
+
+    /**
+     * Years of catch history to harvest in each repeat
+     */
+    Time start = 2000;
+    Time finish = 2009;
+
+    /**
+     * Random seed (the same for all allocations and repeats)
+     */
+    unsigned int seed = 42;
+
+    void run(const Parameters& parameters) {
+        boost::filesystem::create_directories("output");
+        Output file("output/harvest_benchmark.tsv", parameters.output_compression);
+        file << "pages\tplacement\tinstances\trepeat\tseconds\thuge_mb\n";
+
+        for (const auto& allocation : allocations) {
+            for (unsigned int repeat = 0; repeat < repeats; repeat++) {
+                Parameters benchmark = parameters;
+                benchmark.fishes_pages = allocation[0];
+                benchmark.fishes_placement = allocation[1];
+
+                std::unique_ptr<Model> model(new Model);
+                model->context.seed(seed);
+                model->initialise(benchmark);
+
+                // Seed the population and scale it to pristine biomass
+                auto& context = model->context;
+                auto& fishes = model->fishes;
+                context.now = start;
+                fishes.seed(context, instances);
+                fishes.biomass_spawners_update(context);
+                fishes.scalar = sum(benchmark.fishes_b0)/sum(fishes.biomass_spawners);
+
+                auto began = std::chrono::steady_clock::now();
+                for (context.now = start; context.now <= finish; context.now++) {
+                    model->monitor.reset(context);
+                    model->harvesting();
+                }
+                std::chrono::duration<double> duration = std::chrono::steady_clock::now() - began;
+
+                auto huge = huge_pages();
+                std::cout
+                    << allocation << "\t"
+                    << repeat << "\t"
+                    << duration.count() << "s\t"
+                    << huge/1e6 << "MB huge pages" << std::endl;
+                file
+                    << allocation[0] << "\t"
+                    << allocation[1] << "\t"
+                    << instances << "\t"
+                    << repeat << "\t"
+                    << duration.count() << "\t"
+                    << huge/1e6 << "\n";
+            }
+        }
+    }
+
+    /**
+     * Get the number of bytes of the process's memory that are backed by
+     * huge pages (transparent or explicit)
+     */
+    static double huge_pages(void) {
+        double bytes = 0;
+        std::ifstream file("/proc/self/smaps_rollup");
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream stream(line);
+            std::string name;
+            double kb;
+            stream >> name >> kb;
+            if (not stream.fail() and (name == "AnonHugePages:" or name == "Private_Hugetlb:")) {
+                bytes += kb * 1024;
+            }
+        }
+        return bytes;
+    }
+
+};  // class HarvestBenchmark
@@ -22,11 +22,12 @@ class Harvest {
 
     Array<double, Regions, Methods> catch_taken;
 
-    unsigned int attempts;
+    std::size_t attempts;
 
 
 
-    void initialise(void){
+    void initialise(const Context& context){
+        auto& parameters = context.parameters;
         for (auto method : methods) {
             for (auto length_bin : lengths) {
                 auto steep1 = parameters.harvest_sel_steep1(method);
@@ -41,11 +42,11 @@ class Harvest {
         }
     }
 
-    void biomass_vulnerable_update(const Fishes& fishes) {
+    void biomass_vulnerable_update(const Context& context, const Fishes& fishes) {
         biomass_vulnerable = 0;
         for (const Fish& fish : fishes) {
             if (fish.alive()) {
-                auto weight = fish.weight();
+                auto weight = fish.weight(context) * fish.count;
                 auto length_bin = fish.length_bin();
                 for (auto method : methods) {
                     biomass_vulnerable(fish.region,method) += weight * selectivity_at_length(method,length_bin);
@@ -55,21 +56,21 @@ class Harvest {
         biomass_vulnerable *= fishes.scalar;
     }
 
-    void catch_observed_update(void) {
-        auto y = year(now);
+    void catch_observed_update(const Context& context) {
+        auto y = year(context.now);
         if (y >= Years_min and y <= Years_max) {
             for (auto region : regions) {
                 for(auto method : methods) {
-                    auto catches = parameters.harvest_catch_history(y,region,method);
+                    auto catches = context.parameters.harvest_catch_history(y,region,method);
                     catch_observed(region,method) = catches;
                 }
             }
         }
     }
 
-    void finalise(void) {
+    void finalise(const Context& context) {
         boost::filesystem::create_directories("output/harvest");
-        selectivity_at_length.write("output/harvest/selectivity_at_length.tsv");
+        Output::write(selectivity_at_length, "output/harvest/selectivity_at_length.tsv", context.parameters.output_compression);
     }
 
 };  // class Harvest
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "model.hpp"
+
+/**
+ * Several scenarios advanced in lockstep
+ *
+ * For scenarios that only differ in harvest-side settings (`harvest_mls`,
+ * `harvest_handling_mortality` and `harvest_catch_history`) the natural processes
+ * acting on the "same" fish are identical across scenarios. This engine takes
+ * advantage of that:
+ *
+ *  - the pristine population is generated once and copied to each scenario
+ *  - recruits are inserted at the same slot in each scenario's population so
+ *    that slot `i` holds the same fish in all scenarios in which it is alive
+ *  - the population is updated in a single pass over slots with the natural
+ *    processes for each fish computed once and shared by all scenarios in which
+ *    it is alive (and in the same state)
+ *
+ * Populations can change size separately in each scenario: rescaling (see
+ * `Fishes::rescale()`) thins or upsamples each scenario's population, and splitting
+ * of super-individuals (`Fishes::split()` and `Fishes::single()` for tag releases)
+ * appends fish. Slots then no longer hold the same fish in all scenarios, so each
+ * scenario's fish are all updated (up to its own size) and natural processes are
+ * only shared between fish in the same slot that are the same fish in the same
+ * state (and otherwise calculated separately).
+ *
+ * Common random numbers (`random_common`) are always on, and all scenarios
+ * have the same seed, so that differences between scenarios are not confounded
+ * with random variation. Harvesting, and monitoring, is done separately for each
+ * scenario.
+ */
+class Lockstep {
+ public:
+
+    /**
+     * Names of scenarios
+     */
+    std::vector<std::string> names;
+
+    /**
+     * A model for each scenario
+     */
+    std::vector<std::unique_ptr<Model>> scenarios;
+
+    /**
+     * Add a scenario
+     *
+     * Only the harvest-side settings of `parameters` are used. All other
+     * parameters are taken from the first scenario added.
+     */
+    void add(const std::string& name, const Parameters& parameters) {
+        std::unique_ptr<Model> model(new Model);
+        if (scenarios.size() == 0) {
+            model->context.parameters = parameters;
+        } else {
+            model->context.parameters = scenarios[0]->context.parameters;
+            model->context.parameters.harvest_mls = parameters.harvest_mls;
+            model->context.parameters.harvest_handling_mortality = parameters.harvest_handling_mortality;
+            model->context.parameters.harvest_catch_history = parameters.harvest_catch_history;
+            // Same seed as the first scenario
+            model->context.random = scenarios[0]->context.random;
+            model->context.key = scenarios[0]->context.key;
+        }
+        model->context.parameters.random_common = true;
+        model->initialise(model->context.parameters);
+        names.push_back(name);
+        scenarios.push_back(std::move(model));
+    }
+
+    /**
+     * Read scenarios from sub-directories
+     *
+     * Each sub-directory of `directory` is a scenario which can have the files
+     * `parameters.json` (of which only `harvest_handling_mortality` is used),
+     * `harvest_mls.tsv` and `harvest_catch_history.tsv` to override `parameters`.
+     */
+    void read(const Parameters& parameters, const std::string& directory = "input/scenarios") {
+        std::vector<std::string> paths;
+        if (boost::filesystem::exists(directory)) {
+            for (const auto& entry : boost::filesystem::directory_iterator(directory)) {
+                if (boost::filesystem::is_directory(entry.path())) paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+
+        for (const auto& path : paths) {
+            Parameters scenario = parameters;
+
+            #define IFE(FILE, WHAT) if(boost::filesystem::exists(path + FILE)) WHAT(path + FILE)
+
+            IFE("/parameters.json", scenario.read);
+            IFE("/harvest_mls.tsv", scenario.harvest_mls.read);
+            IFE("/harvest_catch_history.tsv", scenario.harvest_catch_history.read);
+
+            #undef IFE
+
+            add(boost::filesystem::path(path).filename().string(), scenario);
+        }
+    }
+
+    /**
+     * Seed the random number generator of all scenarios
+     */
+    void seed(unsigned int value) {
+        for (auto& model : scenarios) model->context.seed(value);
+    }
+
+    /**
+     * Update all scenarios for a time step
+     */
+    void update(void) {
+        auto& first = *scenarios[0];
+        auto now = first.context.now;
+        bool burnin = (year(now) < Years_min);
+
+        for (auto& model : scenarios) {
+            model->context.now = now;
+            if (not burnin) {
+                model->monitor.reset(model->context);
+                model->fishes.rescale(model->context);
+            }
+            model->spawning();
+            model->fishes.split(model->context);
+        }
+
+        recruits();
+
+        /*****************************************************************
+         * Fish population dynamics
+         ****************************************************************/
+
+        auto size = this->size();
+        for (unsigned int slot = 0; slot < size; slot++) {
+            // Update the fish in the first scenario in which it is alive
+            Model* leader = nullptr;
+            Fish before = Fish();
+            for (auto& model : scenarios) {
+                if (slot >= model->fishes.size()) continue;
+                Fish& fish = model->fishes[slot];
+                if (not fish.alive()) continue;
+
+                if (not leader) {
+                    leader = model.get();
+                    before = fish;
+                    leader->dynamics(fish, burnin);
+                } else if (same(fish, before)) {
+                    // Share the outcome of natural processes with the leader. Tags
+                    // are specific to each scenario so shedding is done separately
+                    const Fish& updated = leader->fishes[slot];
+                    fish.death = updated.death;
+                    fish.count = updated.count;
+                    if (fish.alive()) {
+                        fish.length = updated.length;
+                        fish.mature = updated.mature;
+                        fish.region = updated.region;
+                        fish.shedding(model->context);
+                        if (not burnin) model->monitor.population(model->context, fish);
+                    }
+                } else {
+                    model->dynamics(fish, burnin);
+                }
+            }
+        }
+
+        if (burnin) return;
+
+        for (auto& model : scenarios) model->harvesting();
+    }
+
+    /**
+     * Take the population to pristine equilibrium
+     *
+     * Done for the first scenario and then copied to the others
+     * (there is no harvesting during burn in)
+     */
+    void pristine(Time time) {
+        auto& first = *scenarios[0];
+        first.pristine(time);
+        for (unsigned int index = 1; index < scenarios.size(); index++) {
+            auto& model = *scenarios[index];
+            static_cast<Blocks<Fish>&>(model.fishes) = first.fishes;
+            model.fishes.scalar = first.fishes.scalar;
+            model.fishes.recruitment_mode = first.fishes.recruitment_mode;
+            model.fishes.recruitment_pristine = first.fishes.recruitment_pristine;
+            model.fishes.biomass_spawners = first.fishes.biomass_spawners;
+            model.context.now = first.context.now;
+            model.context.random = first.context.random;
+        }
+    }
+
+    /**
+     * Run all scenarios over a time period, starting in pristine conditions
+     *
+     * @param callback Called after each time step
+     */
+    void run(Time start, Time finish, std::function<void()>* callback = 0) {
+        pristine(start);
+        for (auto now = start; now <= finish; now++) {
+            for (auto& model : scenarios) model->context.now = now;
+            update();
+            if (callback) (*callback)();
+        }
+        for (auto& model : scenarios) model->context.now = finish + 1;
+    }
+
+    /**
+     * Write the monitoring outputs of each scenario
+     */
+    void finalise(const std::string& directory = "output/lockstep") {
+        for (unsigned int index = 0; index < scenarios.size(); index++) {
+            auto& model = *scenarios[index];
+            model.monitor.finalise(model.context, directory + "/" + names[index] + "/monitor");
+        }
+    }
+
+ private:
+
+    /**
+     * The largest number of slots in any scenario's population
+     */
+    unsigned int size(void) const {
+        unsigned int size = 0;
+        for (const auto& model : scenarios) size = std::max(size, model->fishes.size());
+        return size;
+    }
+
+    /**
+     * Are two instances of a fish in the same state with respect to natural processes?
+     */
+    static bool same(const Fish& a, const Fish& b) {
+        return a.id == b.id and
+            a.birth == b.birth and
+            a.length == b.length and
+            a.mature == b.mature and
+            a.region == b.region and
+            a.count == b.count;
+    }
+
+    /**
+     * Create recruits and insert them into each scenario's population
+     *
+     * Scenarios can have differing numbers of recruits (because of differing
+     * spawning biomass). Each recruit is inserted at the same slot in every scenario,
+     * a slot that is free in all of them (or beyond the end of a scenario's
+     * population), and is left dead in scenarios with fewer recruits.
+     */
+    void recruits(void) {
+        auto& first = *scenarios[0];
+        auto& context = first.context;
+
+        unsigned int slot = 0;
+        for (auto region : regions) {
+            unsigned int instances = 0;
+            for (auto& model : scenarios) {
+                instances = std::max(instances, model->fishes.recruitment_instances(region));
+            }
+            for (unsigned int index = 0; index < instances; index++) {
+                Fish recruit;
+                recruit.born(context, Region(region.index()), index);
+                Fish unborn = recruit;
+                unborn.dies(context);
+
+                // Find a slot that is empty in all scenarios, or add one to the end
+                auto size = this->size();
+                while (slot < size) {
+                    bool empty = true;
+                    for (auto& model : scenarios) {
+                        if (slot < model->fishes.size() and model->fishes[slot].alive()) {
+                            empty = false;
+                            break;
+                        }
+                    }
+                    if (empty) break;
+                    slot++;
+                }
+
+                for (auto& model : scenarios) {
+                    const Fish& fish = (index < model->fishes.recruitment_instances(region)) ? recruit : unborn;
+                    // Pad smaller populations so that the recruit is in the same slot
+                    while (model->fishes.size() < slot) model->fishes.push_back(unborn);
+                    if (slot < model->fishes.size()) model->fishes[slot] = fish;
+                    else model->fishes.push_back(fish);
+                }
+            }
+        }
+    }
+
+};  // class Lockstep
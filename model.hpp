@@ -1,13 +1,12 @@
 #pragma once
 
-#include "random.hpp"
-
-#include "parameters.hpp"
+#include "context.hpp"
 
 #include "environ.hpp"
 #include "fishes.hpp"
 #include "harvest.hpp"
 #include "monitor.hpp"
+#include "cohorts.hpp"
 
 /**
  * The model
@@ -17,25 +16,69 @@
 class Model {
  public:
 
+    /**
+     * The context (time, parameters and random number generator)
+     * of this model
+     */
+    Context context;
+
     Environ environ;
     Fishes fishes;
     Harvest harvest;
     Monitor monitor;
 
+    /**
+     * Background writer for outputs (if `output_queue` is not zero)
+     */
+    std::unique_ptr<Writer> writer;
+
     void initialise(void) {
-        parameters.initialise();
+        context.parameters.initialise();
+        initialise(context.parameters);
+    }
+
+    /**
+     * Initialise using parameters that have already been read in
+     *
+     * Allows several models in the one process to share inputs
+     * without each re-reading them from file.
+     */
+    void initialise(const Parameters& parameters) {
+        if (&parameters != &context.parameters) context.parameters = parameters;
         environ.initialise();
-        fishes.initialise();
-        harvest.initialise();
+        fishes.initialise(context);
+        harvest.initialise(context);
         monitor.initialise();
+        auto queue = context.parameters.output_queue;
+        writer.reset(queue ? new Writer(queue * 1e6) : nullptr);
     }
 
     void finalise(void) {
-        parameters.finalise();
-        environ.finalise();
-        fishes.finalise();
-        harvest.finalise();
-        monitor.finalise();
+        if (writer) {
+            // Hand off copies of parameters, harvest and monitor outputs to the writer
+            // and finalise fishes (which requires the population) while they are written
+            std::shared_ptr<Context> context_copy(new Context(context));
+            std::shared_ptr<Harvest> harvest_copy(new Harvest(harvest));
+            std::shared_ptr<Monitor> monitor_copy(new Monitor(monitor));
+            writer->submit([context_copy](){
+                context_copy->parameters.finalise();
+            }, sizeof(Context));
+            writer->submit([context_copy, harvest_copy](){
+                harvest_copy->finalise(*context_copy);
+            }, sizeof(Harvest));
+            writer->submit([context_copy, monitor_copy](){
+                monitor_copy->finalise(*context_copy);
+            }, sizeof(Monitor) + monitor.tagging.tags.bytes());
+            environ.finalise();
+            fishes.finalise(context);
+            writer->wait();
+        } else {
+            context.parameters.finalise();
+            environ.finalise();
+            fishes.finalise(context);
+            harvest.finalise(context);
+            monitor.finalise(context);
+        }
     }
 
     /**
@@ -46,28 +89,31 @@ class Model {
      * the population of fish
      */
     void update(void) {
-        auto y = year(now);
+        auto y = year(context.now);
         bool burnin = (y < Years_min);
 
         // Reset the monitoring counts
-        if (not burnin) monitor.reset();
+        if (not burnin) monitor.reset(context);
+
+        // Keep the number of instances within limits (not during burn in
+        // because `scalar` is set at the end of it)
+        if (not burnin) fishes.rescale(context);
 
         /*****************************************************************
          * Spawning and recruitment
          ****************************************************************/
 
-        // Update spawning biomass
-        fishes.biomass_spawners_update();
+        spawning();
 
-        // Update recruitment
-        fishes.recruitment_update();
+        // Split any super-individuals that have reached `fishes_split_age`
+        fishes.split(context);
 
         // Create and insert each recruit into the population
         unsigned int slot = 0;
         for (auto region : regions) {
             for (unsigned int index = 0; index < fishes.recruitment_instances(region); index++){
                 Fish recruit;
-                recruit.born(Region(region.index()));
+                recruit.born(context, Region(region.index()), index);
 
                 // Find a "slot" in population to insert this recruit
                 // If no empty slot found add to end of fish population
@@ -90,21 +136,66 @@ class Model {
          ****************************************************************/
 
         for (Fish& fish : fishes) {
-            if (fish.alive()) {
-                if (fish.survival()) {
-                    fish.growth();
-                    fish.maturation();
-                    fish.movement();
-                    fish.shedding();
-
-                    if (not burnin) monitor.population(fish);
-                }
-            }
+            if (fish.alive()) dynamics(fish, burnin);
         }
 
         // Don't go further if in burn in
         if (burnin) return;
 
+        harvesting();
+
+        if (context.parameters.fishes_track) fishes.track(context, writer.get());
+    }
+
+    /**
+     * Update spawning biomass and recruitment
+     */
+    void spawning(void) {
+        // Population scans until harvesting are sequential
+        fishes.advise('s');
+        fishes.biomass_spawners_update(context);
+        fishes.recruitment_update(context);
+    }
+
+    /**
+     * Update a live fish for natural processes (survival, growth, maturation,
+     * movement and tag shedding) and monitor it
+     *
+     * @return Did the fish survive?
+     */
+    bool dynamics(Fish& fish, bool burnin) {
+        if (fish.survival(context)) {
+            fish.growth(context);
+            fish.maturation(context);
+            fish.movement(context);
+            fish.shedding(context);
+
+            if (not burnin) monitor.population(context, fish);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Maximum number of random draws of fish when tagging or harvesting
+     *
+     * Calculated in 64 bits since, for large populations (e.g. of file
+     * backed blocks) with super-individuals, it exceeds 32 bits.
+     */
+    static std::size_t attempts_limit(std::size_t instances, unsigned int recruit_count) {
+        return instances * 100 * std::size_t(std::max(recruit_count, 1u));
+    }
+
+    /**
+     * Harvesting and monitoring after natural processes in a time step
+     */
+    void harvesting(void) {
+        auto& parameters = context.parameters;
+        auto y = year(context.now);
+
+        // Fish are chosen at random for tagging and harvest (in batches from
+        // blocks if `harvest_sampling_batch` is set)
+        fishes.advise('n');
 
         /*****************************************************************
          * Monitoring (independent of harvesting e.g. tag release)
@@ -121,32 +212,38 @@ class Model {
         }
         int releases_done = 0;
 
-        unsigned int trials = 0;
+        // Super-individuals are picked in proportion to their count so
+        // more trials may be needed
+        auto trials_max = attempts_limit(fishes.size(), parameters.fishes_recruit_count);
+        std::size_t trials = 0;
         while(releases_done < releases_targetted) {
             // Randomly choose a fish
-            Fish& fish = fishes[chance()*fishes.size()];
+            unsigned int index = fishes.choose(context);
+            Fish& fish = fishes[index];
             // If the fish is alive, and not yet tagged then...
-            if (fish.alive() and not fish.tag and fish.length >= monitor.tagging.release_length_min) {
+            if (fish.alive() and not fish.tag and fish.length >= monitor.tagging.release_length_min and fish.picked(context)) {
                 // Randomly choose a fishing method in the region the fish currently resides
-                auto method = Method(methods.select(chance()).index());
+                auto method = Method(methods.select(context.chance()).index());
                 auto region = fish.region;
                 // If the tag releases for the method in the region is not yet acheived...
                 if (monitor.tagging.released(y, region, method) < parameters.tagging_releases(y, region, method)) {
                     // Is this fish caught by this method?
                     auto selectivity = harvest.selectivity_at_length(method, fish.length_bin());
-                    if ((!monitor.tagging.release_length_selective) || (chance() < selectivity)) {
-                        // Tag and release the fish
-                        monitor.tagging.release(fish, method);
-                        fish.released(method);
+                    if ((!monitor.tagging.release_length_selective) || (context.chance() < selectivity)) {
+                        // Tag and release the fish (split from a super-individual
+                        // so that tagged fish are single individuals)
+                        Fish& tagged = fishes.single(index);
+                        monitor.tagging.release(context, tagged, method);
+                        tagged.released(method);
                         // Increment the number of releases
                         releases_done++;
                         // Apply tagging mortality
-                        if (chance() < parameters.tagging_mortality) fish.dies();
+                        if (context.chance() < parameters.tagging_mortality) tagged.dies(context);
                     }
                 }
             }
             // Escape if too many trials
-            if (trials++ > fishes.size() * 100) {
+            if (trials++ > trials_max) {
                 std::cerr << trials << " " << releases_done << " " << releases_targetted << std::endl;
                 throw std::runtime_error("Too many attempts to tag fish. Something is probably wrong.");
             }
@@ -158,7 +255,7 @@ class Model {
 
         // Update the current catches by region/method
         // from the catch history
-        harvest.catch_observed_update();
+        harvest.catch_observed_update(context);
 
         // Reset the harvesting accounting
         harvest.attempts = 0;
@@ -169,45 +266,46 @@ class Model {
 
         // If there was observed catch then randomly draw fish and "assign" them with varying probabilities
         // to a particular region/method catch
+        auto attempts_max = attempts_limit(fishes.size(), parameters.fishes_recruit_count);
         while(catch_observed > 0) {
             // Randomly choose a fish
-            Fish& fish = fishes[chance()*fishes.size()];
+            Fish& fish = fishes[fishes.choose(context)];
             // If the fish is alive, then...
             if (fish.alive()) {
                 auto region = fish.region;
 
                 // Randomly choose a fishing method in the region the fish currently resides
-                auto method = Method(methods.select(chance()).index());
+                auto method = Method(methods.select(context.chance()).index());
                 // If the catch for the method in the region is not yet caught...
                 if (harvest.catch_taken(region, method) < harvest.catch_observed(region, method)) {
                     // Is this fish caught by this method?
                     auto selectivity = harvest.selectivity_at_length(method, fish.length_bin());
                     auto boldness = (method == fish.method_last) ? (1 - parameters.fishes_shyness(method)) : 1;
-                    if (chance() < selectivity * boldness) {
+                    if (fish.picked(context) and context.chance() < selectivity * boldness) {
                         // Is this fish greater than the MLS and thus retained?
                         if (fish.length >= parameters.harvest_mls(method)) {
-                            // Kill the fish
-                            fish.dies();
+                            // Kill the fish (or one of the individuals it represents)
+                            fish.decrement(context);
                             
                             // Add to catch taken for region/method
-                            double fish_biomass = fish.weight() * fishes.scalar;
+                            double fish_biomass = fish.weight(context) * fishes.scalar;
                             harvest.catch_taken(region, method) += fish_biomass;
                             
                             // Catch sampling, currently 100% sampling of catch
-                            monitor.catch_sample(region, method, fish);
+                            monitor.catch_sample(context, region, method, fish);
 
                             // Update total catch and quit if all taken
                             catch_taken += fish_biomass;
                             if (catch_taken >= catch_observed) break;
 
                             // Is this fish scanned for a tag?
-                            if (chance() < parameters.tagging_scanning(y, region, method)) {
-                                monitor.tagging.scan(fish, method);
+                            if (context.chance() < parameters.tagging_scanning(y, region, method)) {
+                                monitor.tagging.scan(context, fish, method);
                             }
                         } else {
                             // Does this fish die after released?
-                            if (chance() < parameters.harvest_handling_mortality) {
-                                fish.dies();
+                            if (context.chance() < parameters.harvest_handling_mortality) {
+                                fish.decrement(context);
                             } else {
                                 fish.released(method);
                             }
@@ -215,7 +313,7 @@ class Model {
                     }
                 }
                 harvest.attempts++;
-                if (harvest.attempts > fishes.size() * 100) {
+                if (harvest.attempts > attempts_max) {
                     std::cerr << y << std::endl
                               << "Catch taken so far:\n" << harvest.catch_taken << std::endl
                               << "Catch observed:\n" << harvest.catch_observed << std::endl;
@@ -225,10 +323,11 @@ class Model {
         }
 
         // Update harvest.biomass_vulnerable for use in monioring
-        harvest.biomass_vulnerable_update(fishes);
+        fishes.advise('s');
+        harvest.biomass_vulnerable_update(context, fishes);
 
         // Update monitoring
-        monitor.update(fishes, harvest);
+        monitor.update(context, fishes, harvest);
 
     }
 
@@ -239,6 +338,20 @@ class Model {
      * like `biomass_spawners_pristine` and `scalar`
      */
     void pristine(Time time, std::function<void()>* callback = 0){
+        auto& parameters = context.parameters;
+        auto& now = context.now;
+        if (parameters.fishes_burnin == 'c') {
+            // Burn in using a cohort model and sample individuals from it
+            Cohorts cohorts;
+            cohorts.initialise(parameters);
+            cohorts.pristine(time);
+            now = time;
+            cohorts.individuals(context, fishes, parameters.fishes_seed_number);
+            fishes.recruitment_pristine = cohorts.recruitment_pristine;
+            fishes.biomass_spawners_update(context);
+            fishes.recruitment_mode = 'n';
+            return;
+        }
         // Set `now` to some arbitrary time (but high enough that fish
         // will have a birth time (unsigned int) greater than 0)
         now = 200;
@@ -253,7 +366,7 @@ class Model {
                 parameters.fishes_b0(region)/sum(parameters.fishes_b0);
         }
         fishes.scalar = 1;
-        fishes.seed(parameters.fishes_seed_number);
+        fishes.seed(context, parameters.fishes_seed_number);
         // Burn in
         // TODO Currently just burns in for an arbitarty number of iterations
         // Should instead exit when stability in population characteristics
@@ -292,13 +405,13 @@ class Model {
     void run(Time start, Time finish, std::function<void()>* callback = 0, int initial = 0) {
         // Create initial population of fish
         if (initial == 0) pristine(start, callback);
-        else fishes.seed(1e6);
+        else fishes.seed(context, 1e6);
         // Iterate over times
-        now = start;
-        while (now <= finish) {
+        context.now = start;
+        while (context.now <= finish) {
             update();
             if (callback) (*callback)();
-            now++;
+            context.now++;
         }
     }
 
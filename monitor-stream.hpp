@@ -0,0 +1,96 @@
+#pragma once
+
+#include "monitor.hpp"
+
+/**
+ * A monitor sink that writes each year's records to TSV files as the simulation proceeds
+ *
+ * Writes the same records as `Monitor::finalise()` (population numbers, CPUEs, age and
+ * length samples, tagging population numbers, releases and scans, and the files for CASAL)
+ * but only for simulated years. Because age and length samples, and tagging scans, are
+ * written each year they are not retained by the `Monitor` in its `Years` indexed arrays.
+ */
+class MonitorStream : public MonitorSink {
+ public:
+
+    MonitorStream(const Parameters& parameters, const std::string& directory = "output/monitor"):
+        compression_(parameters.output_compression),
+        precision_(parameters.output_precision) {
+        boost::filesystem::create_directories(directory + "/tagging");
+        boost::filesystem::create_directories(directory + "/casal");
+
+        population_numbers_.reset(new File(directory + "/population_numbers.tsv", "year\tregion\tvalue\n", *this));
+        cpues_.reset(new File(directory + "/cpues.tsv", "year\tregion\tmethod\tvalue\n", *this));
+        age_samples_.reset(new File(directory + "/age_samples.tsv", "year\tregion\tmethod\tage\tvalue\n", *this));
+        length_samples_.reset(new File(directory + "/length_samples.tsv", "year\tregion\tmethod\tlength\tvalue\n", *this));
+
+        tagging_population_numbers_.reset(new File(directory + "/tagging/population_numbers.tsv", "year\tregion\tvalue\n", *this));
+        tagging_released_.reset(new File(directory + "/tagging/released.tsv", "year\tregion\tmethod\tvalue\n", *this));
+        tagging_scanned_.reset(new File(directory + "/tagging/scanned.tsv", "year\tregion\tmethod\tlength\tvalue\n", *this));
+
+        casal_.reset(new Monitor::Casal(directory + "/casal", compression_, precision_));
+    }
+
+    void year(const Context& context, const Monitor& monitor) override {
+        auto y = ::year(context.now);
+        const auto& tagging = monitor.tagging;
+
+        for (auto region : regions) {
+            population_numbers_->tsv.row(y, region, monitor.population_numbers(y, region));
+            tagging_population_numbers_->tsv.row(y, region, tagging.population_numbers(y, region));
+            for (auto method : methods) {
+                cpues_->tsv.row(y, region, method, monitor.cpues(y, region, method));
+                tagging_released_->tsv.row(y, region, method, tagging.released(y, region, method));
+                for (auto age : ages) {
+                    age_samples_->tsv.row(y, region, method, age, monitor.age_sample(region, method, age));
+                }
+                for (auto length : lengths) {
+                    length_samples_->tsv.row(y, region, method, length, monitor.length_sample(region, method, length));
+                    tagging_scanned_->tsv.row(y, region, method, length, tagging.scanning(region, method, length));
+                }
+            }
+        }
+
+        monitor.casal_write(*casal_, context.parameters, y, monitor.age_sample, monitor.length_sample);
+    }
+
+    void finalise(void) override {
+        population_numbers_.reset();
+        cpues_.reset();
+        age_samples_.reset();
+        length_samples_.reset();
+        tagging_population_numbers_.reset();
+        tagging_released_.reset();
+        tagging_scanned_.reset();
+        casal_.reset();
+    }
+
+ private:
+
+    char compression_;
+    int precision_;
+
+    /**
+     * An output file and its TSV writer
+     */
+    struct File {
+        Output output;
+        Tsv tsv;
+
+        File(const std::string& path, const char* header, const MonitorStream& stream):
+            output(path, stream.compression_),
+            tsv(output, stream.precision_) {
+            tsv << header;
+        }
+    };
+
+    std::unique_ptr<File> population_numbers_;
+    std::unique_ptr<File> cpues_;
+    std::unique_ptr<File> age_samples_;
+    std::unique_ptr<File> length_samples_;
+    std::unique_ptr<File> tagging_population_numbers_;
+    std::unique_ptr<File> tagging_released_;
+    std::unique_ptr<File> tagging_scanned_;
+    std::unique_ptr<Monitor::Casal> casal_;
+
+};  // class MonitorStream
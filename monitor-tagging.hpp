@@ -1,6 +1,10 @@
 #pragma once
 
+#include <limits>
+
 #include "requirements.hpp"
+#include "sparse.hpp"
+#include "tsv.hpp"
 
 /**
  * Simulation of a tagging programme
@@ -36,8 +40,24 @@ public:
 
     /**
      * The number of fish scanned by year, region, method and length
+     *
+     * Stored sparsely because scanning only happens in some years, regions
+     * and methods. Not recorded if `retain` is false.
+     */
+    Sparse<int, Lengths> scanned;
+
+    /**
+     * The number of fish scanned in the current year by region, method and length
      */
-    Array<int, Years, Regions, Methods, Lengths> scanned;
+    Array<int, Regions, Methods, Lengths> scanning;
+
+    /**
+     * Retain the numbers scanned in each year (in `scanned`)?
+     *
+     * Set to false by `Monitor` when its yearly records are streamed
+     * to a `MonitorSink` instead.
+     */
+    bool retain = true;
 
     /**
      * The current tag number
@@ -48,47 +68,133 @@ public:
     unsigned int number = 0;
 
     /**
-     * A tagging event
-     *
-     * Copies the fish and adds a time stamp
+     * A tagging event (a release or a recapture)
      */
-    class Event : public Fish {
-     public:
+    struct Event {
         Time time;
+        Region region;
         Method method;
+        float length;
+    };
+
+    /**
+     * A database of tagged fish
+     *
+     * Tag numbers are sequential (starting at 1) so events are stored in columns,
+     * indexed by tag number, holding only the fields that are written by
+     * `write()`. A time of zero indicates that the event has not happened
+     * (i.e. that the tag has not been recaptured).
+     */
+    class Tags {
+     public:
 
         /**
-         * Constructor used for both release and
-         * recapture events
+         * Number of tags (the highest tag number)
          */
-        Event(const Fish& fish, Time time, Method method):
-            Fish(fish),
-            time(time),
-            method(method){
+        unsigned int size(void) const {
+            return releases_.time.size();
         }
 
         /**
-         * Default constructer used for the recapture
-         * event when an entry is made in database. 
-         * Signified as empty by `time==0`
+         * Number of bytes used to store the tags
          */
-        Event(void):
-            time(0){
+        std::size_t bytes(void) const {
+            return size() * 2 * (sizeof(uint16_t) + 2 * sizeof(uint8_t) + sizeof(float));
+        }
+
+        void release(unsigned int tag, const Event& event) {
+            grow(tag);
+            releases_.set(tag - 1, event);
+        }
+
+        void release(unsigned int tag, const Fish& fish, Time time, Method method) {
+            release(tag, {time, fish.region, method, fish.length});
+        }
+
+        void recapture(unsigned int tag, const Event& event) {
+            grow(tag);
+            recaptures_.set(tag - 1, event);
+        }
+
+        void recapture(unsigned int tag, const Fish& fish, Time time, Method method) {
+            recapture(tag, {time, fish.region, method, fish.length});
+        }
+
+        Event release(unsigned int tag) const {
+            return releases_.get(tag - 1);
+        }
+
+        Event recapture(unsigned int tag) const {
+            return recaptures_.get(tag - 1);
+        }
+
+     private:
+
+        /**
+         * Columns of events (times are years so fit in 16 bits)
+         */
+        struct Events {
+            std::vector<uint16_t> time;
+            std::vector<uint8_t> region;
+            std::vector<uint8_t> method;
+            std::vector<float> length;
+
+            void resize(unsigned int size) {
+                time.resize(size, 0);
+                region.resize(size, 0);
+                method.resize(size, 0);
+                length.resize(size, 0);
+            }
+
+            void set(unsigned int index, const Event& event) {
+                time[index] = event.time;
+                region[index] = event.region;
+                method[index] = event.method;
+                length[index] = event.length;
+            }
+
+            Event get(unsigned int index) const {
+                return {time[index], Region(region[index]), Method(method[index]), length[index]};
+            }
+        };
+
+        Events releases_;
+        Events recaptures_;
+
+        void grow(unsigned int tag) {
+            if (tag > size()) {
+                releases_.resize(tag);
+                recaptures_.resize(tag);
+            }
         }
     };
 
-    /**
-     * A database of tagged fish
-     *
-     * A fish instance is stored at the time of release and recovery
-     */
-    std::map<int, std::pair<Event, Event> > tags;
+    Tags tags;
 
 
     void initialise(void) {
         population_numbers = 0;
         released = 0;
-        scanned = 0;
+        scanned.clear();
+        scanning = 0;
+    }
+
+    /**
+     * Reset things at the start of each time step
+     */
+    void reset(void) {
+        scanning = 0;
+    }
+
+    /**
+     * Update things at the end of each time step
+     */
+    void update(const Context& context) {
+        if (not retain) return;
+        auto y = year(context.now);
+        for (auto region : regions) {
+            for (auto method : methods) scanned.set(y, region.index(), method.index(), scanning);
+        }
     }
 
     void finalise(void) {
@@ -104,29 +210,29 @@ public:
      * 
      * @param fish   A fish
      */
-    void population(const Fish& fish) {
-        auto y = year(now);
+    void population(const Context& context, const Fish& fish) {
+        auto y = year(context.now);
         // Add fish to numbers by Year and Region
-        if (fish.length >= release_length_min) population_numbers(y, fish.region)++;
+        if (fish.length >= release_length_min) population_numbers(y, fish.region) += fish.count;
     }
 
     /**
      * A mark and release of a fish.
      */
-    void release(Fish& fish, Method method) {
+    void release(const Context& context, Fish& fish, Method method) {
         // Increment the tag number
         number++;
         // Apply the tag to the fish
         fish.tag = number;
         // Record the fish in the database
-        tags[number].first = Event(fish, now, method);
+        tags.release(number, fish, context.now, method);
         // Add to released
-        released(year(now), fish.region, method)++;
+        released(year(context.now), fish.region, method)++;
     }
 
-    void scan(const Fish& fish, Method method) {
-        scanned(year(now), fish.region, method, fish.length_bin())++;
-        if (fish.tag and chance() < parameters.tagging_detection) recover(fish, method);
+    void scan(Context& context, const Fish& fish, Method method) {
+        scanning(fish.region, method, fish.length_bin())++;
+        if (fish.tag and context.chance() < context.parameters.tagging_detection) recover(context, fish, method);
     }
 
     /**
@@ -135,48 +241,292 @@ public:
      * Note that this method does not actually kill the 
      * fish (done elsewhere) it just records it
      */
-    void recover(const Fish& fish, Method method) {
+    void recover(const Context& context, const Fish& fish, Method method) {
         // Record the fish in the database
-        tags[fish.tag].second = Event(fish, now, method);
+        tags.recapture(fish.tag, fish, context.now, method);
+    }
+
+    /**
+     * A tag based estimate of the number of fish in a region
+     */
+    struct Estimate {
+        /**
+         * Number of tags released in the region in the release year (M)
+         */
+        unsigned int released = 0;
+
+        /**
+         * Number of fish scanned in the region in the recapture year (C)
+         */
+        unsigned int scanned = 0;
+
+        /**
+         * Number of those tags recaptured in the region in the recapture year (R)
+         */
+        unsigned int recaptured = 0;
+
+        /**
+         * Estimated number of fish and its variance
+         */
+        double estimate = 0;
+        double variance = 0;
+
+        /**
+         * Actual number of fish (from `population_numbers` in the release year)
+         */
+        double actual = 0;
+
+        /**
+         * Relative error of the estimate
+         */
+        double error(void) const {
+            return estimate / actual - 1;
+        }
+    };
+
+    /**
+     * Petersen estimates of the number of fish in each region
+     *
+     * Uses Chapman's form of the Petersen estimator, `(M+1)(C+1)/(R+1) - 1`, which
+     * is nearly unbiased (and defined when there are no recaptures), with Seber's
+     * variance, `(M+1)(C+1)(M-R)(C-R)/((R+1)^2(R+2))`. Each region is treated as a
+     * closed population so tags released in other regions, or recaptured in other
+     * regions, are ignored. Assumes that all tags on scanned fish are detected
+     * (i.e. `tagging_detection` is 1) and that there is no tag loss.
+     *
+     * Calculated from the tag database and the numbers released and scanned,
+     * so no files are written or read. Requires that scans are retained.
+     *
+     * @param release_year Year that tags were released
+     * @param recapture_year Year that tags were recaptured (can be the same as the release year)
+     */
+    std::vector<Estimate> petersen(unsigned int release_year, unsigned int recapture_year) const {
+        if (not retain) throw std::runtime_error("Petersen estimates require that scans are retained");
+
+        std::vector<Estimate> estimates(Regions::size());
+        for (auto region : regions) {
+            auto& estimate = estimates[region.index()];
+            for (auto method : methods) {
+                estimate.released += released(release_year, region, method);
+                auto slice = scanned.find(recapture_year, region.index(), method.index());
+                if (slice) estimate.scanned += sum(*slice);
+            }
+            estimate.actual = population_numbers(release_year, region);
+        }
+
+        for (unsigned int tag = 1; tag <= tags.size(); tag++) {
+            auto release = tags.release(tag);
+            auto recapture = tags.recapture(tag);
+            if (
+                year(release.time) == release_year and
+                year(recapture.time) == recapture_year and
+                recapture.region == release.region
+            ) estimates[release.region].recaptured++;
+        }
+
+        for (auto& estimate : estimates) {
+            double m = estimate.released;
+            double c = estimate.scanned;
+            double r = estimate.recaptured;
+            estimate.estimate = (m + 1) * (c + 1) / (r + 1) - 1;
+            estimate.variance = (m + 1) * (c + 1) * (m - r) * (c - r) / ((r + 1) * (r + 1) * (r + 2));
+        }
+        return estimates;
     }
 
     void read(void) {
     }
 
-    void write(std::string directory = "output/monitor/tagging") {
+    void write(std::string directory = "output/monitor/tagging", char compression = 'n', int precision = 6) {
         boost::filesystem::create_directories(directory);
         
-        population_numbers.write(directory + "/population_numbers.tsv");
-        released.write(directory + "/released.tsv");
-        scanned.write(directory + "/scanned.tsv");
+        // If not retained, yearly records are written by a `MonitorSink`
+        if (retain) {
+            Output::write(population_numbers, directory + "/population_numbers.tsv", compression);
+            Output::write(released, directory + "/released.tsv", compression);
+            Output::write(scanned, directory + "/scanned.tsv", compression);
+        }
 
-        std::ofstream releases_file(directory + "/releases.tsv");
+        Output releases_output(directory + "/releases.tsv", compression);
+        Tsv releases_file(releases_output, precision);
         releases_file << "tag\ttime_rel\tregion_rel\tmethod_rel\tlength_rel\n";
-        for(const auto& iter : tags){
-            auto number = iter.first;
-            auto release = iter.second.first;
-            releases_file<< number << "\t"
-                << release.time << "\t"
-                << region_code(release.region) << "\t"
-                << method_code(release.method) << "\t"
-                << release.length << "\n";
+        for(unsigned int tag = 1; tag <= tags.size(); tag++){
+            auto release = tags.release(tag);
+            releases_file.row(
+                tag,
+                release.time,
+                region_code(release.region),
+                method_code(release.method),
+                release.length
+            );
         }
 
-        std::ofstream recaptures_file(directory + "/recaptures.tsv");
+        Output recaptures_output(directory + "/recaptures.tsv", compression);
+        Tsv recaptures_file(recaptures_output, precision);
         recaptures_file << "tag\ttime_rel\ttime_rec\tregion_rel\tregion_rec\tmethod_rel\tmethod_rec\tlength_rel\tlength_rec\n";
-        for(const auto& iter : tags){
-            auto number = iter.first;
-            auto release = iter.second.first;
-            auto recapture = iter.second.second;
+        for(unsigned int tag = 1; tag <= tags.size(); tag++){
+            auto release = tags.release(tag);
+            auto recapture = tags.recapture(tag);
             if(recapture.time){
-                recaptures_file<< number << "\t"
-                    << release.time << "\t" << recapture.time << "\t"
-                    << region_code(release.region) << "\t" << region_code(recapture.region) << "\t"
-                    << method_code(release.method) << "\t" << method_code(recapture.method) << "\t"
-                    << release.length << "\t" << recapture.length << "\n";
+                recaptures_file.row(
+                    tag,
+                    release.time, recapture.time,
+                    region_code(release.region), region_code(recapture.region),
+                    method_code(release.method), method_code(recapture.method),
+                    release.length, recapture.length
+                );
             }
         }
 
     }
 
 };  // class Tagging
+
+
+/**
+ * Records tagging events from several threads for a deterministic merge into `Tagging`
+ *
+ * If tag release or harvest is run on several threads (e.g. each over a partition
+ * of the population) then calling `Tagging::release()`, `scan()` and `recover()`
+ * directly would require serialising on the tag number and on the tag database and
+ * counts. Instead, each thread records events in its own `Buffer` and, at the end of
+ * the step (or phase of a step), `merge()` adds them to the `Tagging` in order of
+ * partition and then of recording. The result therefore only depends on how the
+ * population is partitioned, not on thread scheduling. If partitions are contiguous
+ * ranges of slots, tag numbers are those given by a sequential pass over the slots.
+ *
+ * Tag numbers are only allocated on merge: released fish are given the `pending` tag
+ * (so they are not tagged twice) and recoveries of them are resolved on merge.
+ */
+class TaggingRecorder {
+ public:
+
+    /**
+     * Tag of fish released into a buffer but not yet merged
+     */
+    static const unsigned int pending = std::numeric_limits<unsigned int>::max();
+
+    /**
+     * Events recorded by one thread
+     */
+    class Buffer {
+     public:
+
+        /**
+         * Numbers released into this buffer by region and method (e.g.
+         * for checking against release targets)
+         */
+        Array<int, Regions, Methods> released = 0;
+
+        /**
+         * Numbers scanned into this buffer by region, method and length
+         */
+        Array<int, Regions, Methods, Lengths> scanning = 0;
+
+        /**
+         * A mark and release of a fish (see `Tagging::release()`)
+         */
+        void release(const Context& context, Fish& fish, Method method) {
+            fish.tag = pending;
+            releases_.push_back({&fish, {context.now, fish.region, method, fish.length}});
+            released(fish.region, method)++;
+        }
+
+        /**
+         * A scan of a fish for a tag (see `Tagging::scan()`)
+         *
+         * Whether the tag is detected is drawn from a stream keyed on the fish and
+         * the current time (rather than from the context's shared generator) so
+         * that threads do not contend for it and the outcome does not depend on
+         * the order of scans.
+         */
+        void scan(const Context& context, const Fish& fish, Method method) {
+            scanning(fish.region, method, fish.length_bin())++;
+            if (not fish.tag) return;
+            Draws draws(Stream::key(context.key, process_detection, fish.id, context.now));
+            if (draws.chance() < context.parameters.tagging_detection) recover(context, fish, method);
+        }
+
+        /**
+         * A recovery of a tagged fish (see `Tagging::recover()`)
+         */
+        void recover(const Context& context, const Fish& fish, Method method) {
+            recoveries_.push_back({fish.tag, &fish, {context.now, fish.region, method, fish.length}});
+        }
+
+     private:
+
+        friend class TaggingRecorder;
+
+        struct Release {
+            Fish* fish;
+            Tagging::Event event;
+        };
+        std::vector<Release> releases_;
+
+        struct Recovery {
+            unsigned int tag;
+            const Fish* fish;
+            Tagging::Event event;
+        };
+        std::vector<Recovery> recoveries_;
+
+        void clear(void) {
+            released = 0;
+            scanning = 0;
+            releases_.clear();
+            recoveries_.clear();
+        }
+    };
+
+    /**
+     * Create a recorder
+     *
+     * @param partitions Number of buffers (e.g. one for each thread or partition of the population)
+     */
+    TaggingRecorder(unsigned int partitions):
+        buffers_(partitions) {}
+
+    unsigned int size(void) const {
+        return buffers_.size();
+    }
+
+    Buffer& buffer(unsigned int partition) {
+        return buffers_[partition];
+    }
+
+    /**
+     * Merge the events in all buffers into `tagging` and clear the buffers
+     *
+     * Must not be called while other threads are recording.
+     */
+    void merge(const Context& context, Tagging& tagging) {
+        auto y = year(context.now);
+        for (auto& buffer : buffers_) {
+            for (auto& release : buffer.releases_) {
+                tagging.number++;
+                release.fish->tag = tagging.number;
+                tagging.tags.release(tagging.number, release.event);
+            }
+            for (auto region : regions) {
+                for (auto method : methods) {
+                    tagging.released(y, region, method) += buffer.released(region, method);
+                    for (auto length : lengths) tagging.scanning(region, method, length) += buffer.scanning(region, method, length);
+                }
+            }
+        }
+        // Recoveries after all releases so that pending tags have been allocated
+        for (auto& buffer : buffers_) {
+            for (const auto& recovery : buffer.recoveries_) {
+                auto tag = (recovery.tag == pending) ? recovery.fish->tag : recovery.tag;
+                tagging.tags.recapture(tag, recovery.event);
+            }
+            buffer.clear();
+        }
+    }
+
+ private:
+
+    std::vector<Buffer> buffers_;
+
+};  // class TaggingRecorder
@@ -1,11 +1,55 @@
 #pragma once
 
+#include "columnar.hpp"
+#include "sparse.hpp"
+#include "tsv.hpp"
 #include "monitor-tagging.hpp"
+#include "tag-archive.hpp"
+
+class Monitor;
+
+/**
+ * A destination for the records of each year of monitoring
+ *
+ * Allows records to be written (or otherwise consumed) as the
+ * simulation proceeds rather than all at the end of a run.
+ *
+ * @see MonitorStream
+ */
+class MonitorSink {
+ public:
+    virtual ~MonitorSink(void) {}
+
+    /**
+     * Consume the records for the current year
+     *
+     * Called at the end of `Monitor::update()`. The records for the year
+     * are in the current year arrays of the monitor (e.g. `age_sample`) and
+     * in the year's slice of the small `Years` indexed arrays (e.g. `catches`).
+     */
+    virtual void year(const Context& context, const Monitor& monitor) = 0;
+
+    /**
+     * Finish (e.g. close files)
+     */
+    virtual void finalise(void) {}
+};
+
 
 class Monitor {
  public:
     Tagging tagging;
 
+    /**
+     * Sink that records are passed to each year (if any)
+     *
+     * When set, age and length samples, and tagging scans, are not retained
+     * in the `Years` indexed arrays (`age_samples`, `length_samples` and
+     * `Tagging::scanned`) and `finalise()` does not write the files that
+     * the sink is expected to have written.
+     */
+    std::shared_ptr<MonitorSink> sink;
+
     // An optimization to store the current year's monitoring components
     MonitoringComponents components;
 
@@ -51,9 +95,11 @@ class Monitor {
     Array<double, Regions, Methods, Ages> age_sample;
 
     /**
-     * Sample of aged fish by region, method and age bin
+     * Sample of aged fish by year, region, method and age bin
+     *
+     * Stored sparsely because samples are only taken in some years
      */
-    Array<double, Years, Regions, Methods, Ages> age_samples;
+    Sparse<double, Ages> age_samples;
 
     /**
      * Sample of measured fish by region, method and length bin
@@ -62,8 +108,10 @@ class Monitor {
 
     /**
      * Samples of measured fish by year, region, method and length bin
+     *
+     * Stored sparsely because samples are only taken in some years
      */
-    Array<double, Years, Regions, Methods, Lengths> length_samples;
+    Sparse<double, Lengths> length_samples;
 
 
     void initialise(void) {
@@ -74,14 +122,23 @@ class Monitor {
     /**
      * Reset things at the start of each time step
      */
-    void reset() {
-        auto y = year(now);
+    void reset(const Context& context) {
+        auto y = year(context.now);
 
-        components = parameters.monitoring_programme(y);
+        components = context.parameters.monitoring_programme(y);
         population_lengths_sample = 0;
         cpue = 0;
         age_sample = 0;
         length_sample = 0;
+        tagging.reset();
+    }
+
+    /**
+     * Attach a sink that records are passed to each year
+     */
+    void stream(std::shared_ptr<MonitorSink> sink) {
+        this->sink = sink;
+        tagging.retain = not sink;
     }
 
     /**
@@ -93,29 +150,37 @@ class Monitor {
      * 
      * @param fish   A fish
      */
-    void population(const Fish& fish) {
-        auto y = year(now);
+    void population(const Context& context, const Fish& fish) {
+        auto y = year(context.now);
         // Add fish to numbers by Year and Region
-        population_numbers(y, fish.region)++;
+        population_numbers(y, fish.region) += fish.count;
         // Add fish to numbers by Region and Length for current year
-        population_lengths_sample(fish.region, fish.length_bin())++;
+        population_lengths_sample(fish.region, fish.length_bin()) += fish.count;
         // Tagging specific population monitoring
-        tagging.population(fish);
+        tagging.population(context, fish);
     }
 
-    void catch_sample(Region region, Method method, const Fish& fish) {
-        if (components.A) age_sample(region, method, fish.age_bin())++;
+    void catch_sample(const Context& context, Region region, Method method, const Fish& fish) {
+        if (components.A) age_sample(region, method, fish.age_bin(context))++;
         if (components.L) length_sample(region, method, fish.length_bin())++;
     }
 
     /**
      * Update things at the end of each time start
      */
-    void update(const Fishes& fishes, const Harvest& harvest) {
-        auto y = year(now);
+    void update(const Context& context, const Fishes& fishes, const Harvest& harvest) {
+        update(context, fishes.biomass_spawners, harvest);
+    }
+
+    /**
+     * Update things at the end of each time step given the current
+     * spawning biomass (e.g. from `Cohorts`)
+     */
+    void update(const Context& context, const Array<double, Regions>& spawners, const Harvest& harvest) {
+        auto y = year(context.now);
         // Record spawning biomass
         for (auto region : regions) {
-            biomass_spawners(y, region) = fishes.biomass_spawners(region);
+            biomass_spawners(y, region) = spawners(region);
         }   
         // Record catches
         for (auto region : regions) {
@@ -134,11 +199,18 @@ class Monitor {
             }
         }
 
+        tagging.update(context);
+
+        if (sink) {
+            sink->year(context, *this);
+            return;
+        }
+
         // Store current age sample
         if (components.A) {
             for (auto region : regions) {
                 for (auto method : methods) {
-                    for (auto age : ages) age_samples(y, region, method, age) = age_sample(region, method, age);
+                    age_samples.set(y, region.index(), method.index(), age_sample);
                 }
             }
         }
@@ -147,23 +219,37 @@ class Monitor {
         if (components.L) {
             for (auto region : regions) {
                 for (auto method : methods) {
-                    for (auto length : lengths) length_samples(y, region, method, length) = length_sample(region, method, length);
+                    length_samples.set(y, region.index(), method.index(), length_sample);
                 }
             }
         }
     }
 
 
-    void finalise(std::string directory = "output/monitor") {
+    void finalise(Context& context, std::string directory = "output/monitor") {
+        auto& parameters = context.parameters;
+
         boost::filesystem::create_directories(directory);
 
-        tagging.finalise();
+        auto compression = parameters.output_compression;
+        auto precision = parameters.output_precision;
 
-        population_numbers.write(directory + "/population_numbers.tsv");
-        
-        cpues.write(directory + "/cpues.tsv");
-        age_samples.write(directory + "/age_samples.tsv");
-        length_samples.write(directory + "/length_samples.tsv");
+        tagging.write(directory + "/tagging", compression, precision);
+        // Only archive tags if there are any (i.e. if there is a tagging programme)
+        if (tagging.tags.size()) TagArchive::write(tagging.tags, directory + "/tagging/tags.bin");
+
+        if (sink) {
+            // Yearly records have already been written by the sink
+            sink->finalise();
+        } else if (parameters.output_format == 'c') {
+            columnar_write(directory);
+        } else {
+            Output::write(population_numbers, directory + "/population_numbers.tsv", compression);
+            
+            Output::write(cpues, directory + "/cpues.tsv", compression);
+            Output::write(age_samples, directory + "/age_samples.tsv", compression);
+            Output::write(length_samples, directory + "/length_samples.tsv", compression);
+        }
 
         parameters.monitoring_programme.write(
             directory + "/programme.tsv", 
@@ -172,79 +258,30 @@ class Monitor {
                 stream << components.C << "\t" << components.L  << "\t" << components.A;
             }
         );
+        Output::compress(directory + "/programme.tsv", compression);
 
         // Files for CASAL
         auto casal_directory = directory + "/casal";
         boost::filesystem::create_directories(casal_directory);
 
-        std::ofstream catch_file(casal_directory + "/catch.tsv");
-        catch_file << "year\tregion\tmethod\tcatch\n";
-
-        std::ofstream biomass_file(casal_directory + "/biomass.tsv");
-        biomass_file << "year\tregion\tbiomass\n";
-        
-        std::ofstream cpue_file(casal_directory + "/cpue.tsv");
-        cpue_file<<"year\tregion\tmethod\tcpue\n";
-
-        std::ofstream age_file(casal_directory + "/age.tsv");
-        age_file << "year\tregion\tmethod\t";
-        for(auto age : ages) age_file << "age" << age << "\t";
-        age_file << "\n";
-
-        std::ofstream length_file(casal_directory + "/length.tsv");
-        length_file << "year\tregion\tmethod\t";
-        for(auto length : lengths) length_file << "length" << length << "\t";
-        length_file << "\n";
-
-        // Override of `method_code` method to output `REC`
-        auto method_code = [](Stencila::Level<Methods> method){
-            if (method == RE) return std::string("REC");
-            else return ::method_code(method);
-        };
-
-        for (auto year : years) {
-            auto components = parameters.monitoring_programme(year);
-
-            for (auto region : regions) {
-
-                biomass_file 
-                    << year << "\t"
-                    << region_code(region) << "\t"
-                    << biomass_spawners(year, region) << "\n";
-
-                for (auto method : methods) {
-                    catch_file
-                        << year << "\t"
-                        << region_code(region) << "\t"
-                        << method_code(method) << "\t"
-                        << catches(year, region, method) << "\n";
-
-                    if (components.C) {
-                        cpue_file 
-                            << year << "\t"
-                            << region_code(region) << "\t"
-                            << method_code(method) << "\t"
-                            << cpues(year, region, method) << "\n";
-                    }
-
-                    if (components.A) {
-                        age_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
-                        for(auto age : ages) age_file << age_samples(year, region, method, age) << "\t";
-                        age_file << "\n";
-                    }
-
-                    if (components.L) {
-                        length_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
-                        for(auto length : lengths) length_file << length_samples(year, region, method, length) << "\t";
-                        length_file << "\n";
+        if (not sink) {
+            Casal casal(casal_directory, compression, precision);
+            Array<double, Regions, Methods, Ages> age_year;
+            Array<double, Regions, Methods, Lengths> length_year;
+            for (auto year : years) {
+                for (auto region : regions) {
+                    for (auto method : methods) {
+                        for (auto age : ages) age_year(region, method, age) = age_samples(year, region, method, age);
+                        for (auto length : lengths) length_year(region, method, length) = length_samples(year, region, method, length);
                     }
                 }
+                casal_write(casal, parameters, year, age_year, length_year);
             }
-
         }
 
         // Output parameters to be inserted in 'population.csl'
-        std::ofstream population_file(casal_directory + "/parameters.tsv");
+        Output population_output(casal_directory + "/parameters.tsv", compression);
+        Tsv population_file(population_output, precision);
         population_file << "par\tvalue\n";
 
         // Growth parameters
@@ -261,13 +298,16 @@ class Monitor {
             growth_cv = parameters.fishes_growth_temporal_cv;
         } else {
             // Parameters calculated by generating 1000 fish and 
-            // calculating mean and cv of growth parameters
+            // calculating mean and cv of growth parameters (with common
+            // random numbers off so each fish gets different parameters)
+            Context sampling = context;
+            sampling.parameters.random_common = false;
             Mean growth_intercept_mean;
             StandardDeviation growth_intercept_sd;
             Mean growth_slope_mean;
             for (int index = 0; index < 1000; index++) {
                 Fish fish;
-                fish.born(EN);
+                fish.born(sampling, EN, index);
                 growth_intercept_mean.append(fish.growth_intercept);
                 growth_intercept_sd.append(fish.growth_intercept);
                 growth_slope_mean.append(fish.growth_slope);
@@ -281,9 +321,129 @@ class Monitor {
             << "growth_50\t" << growth_50 << "\n"
             << "growth_cv\t" << growth_cv << "\n"
             << "growth_sdmin\t" << growth_sdmin << "\n";
-        population_file.close();
 
     }
 
+    /**
+     * Files for CASAL (catches, biomass, CPUE and age and length samples)
+     */
+    struct Casal {
+        Output catch_output;
+        Output biomass_output;
+        Output cpue_output;
+        Output age_output;
+        Output length_output;
+
+        Tsv catch_file;
+        Tsv biomass_file;
+        Tsv cpue_file;
+        Tsv age_file;
+        Tsv length_file;
+
+        Casal(const std::string& directory, char compression, int precision):
+            catch_output(directory + "/catch.tsv", compression),
+            biomass_output(directory + "/biomass.tsv", compression),
+            cpue_output(directory + "/cpue.tsv", compression),
+            age_output(directory + "/age.tsv", compression),
+            length_output(directory + "/length.tsv", compression),
+            catch_file(catch_output, precision),
+            biomass_file(biomass_output, precision),
+            cpue_file(cpue_output, precision),
+            age_file(age_output, precision),
+            length_file(length_output, precision) {
+            catch_file << "year\tregion\tmethod\tcatch\n";
+            biomass_file << "year\tregion\tbiomass\n";
+            cpue_file<<"year\tregion\tmethod\tcpue\n";
+
+            age_file << "year\tregion\tmethod\t";
+            for(auto age : ages) age_file << "age" << age << "\t";
+            age_file << "\n";
+
+            length_file << "year\tregion\tmethod\t";
+            for(auto length : lengths) length_file << "length" << length << "\t";
+            length_file << "\n";
+        }
+    };
+
+    /**
+     * Write the rows of the CASAL files for a year
+     *
+     * @param age_sample Age sample for the year
+     * @param length_sample Length sample for the year
+     */
+    void casal_write(
+        Casal& casal, const Parameters& parameters, unsigned int year,
+        const Array<double, Regions, Methods, Ages>& age_sample,
+        const Array<double, Regions, Methods, Lengths>& length_sample
+    ) const {
+        // Override of `method_code` method to output `REC`
+        auto method_code = [](Stencila::Level<Methods> method){
+            if (method == RE) return std::string("REC");
+            else return ::method_code(method);
+        };
+
+        auto components = parameters.monitoring_programme(year);
+
+        for (auto region : regions) {
+
+            casal.biomass_file 
+                << year << "\t"
+                << region_code(region) << "\t"
+                << biomass_spawners(year, region) << "\n";
+
+            for (auto method : methods) {
+                casal.catch_file
+                    << year << "\t"
+                    << region_code(region) << "\t"
+                    << method_code(method) << "\t"
+                    << catches(year, region, method) << "\n";
+
+                if (components.C) {
+                    casal.cpue_file 
+                        << year << "\t"
+                        << region_code(region) << "\t"
+                        << method_code(method) << "\t"
+                        << cpues(year, region, method) << "\n";
+                }
+
+                if (components.A) {
+                    casal.age_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
+                    for(auto age : ages) casal.age_file << age_sample(region, method, age) << "\t";
+                    casal.age_file << "\n";
+                }
+
+                if (components.L) {
+                    casal.length_file << year << "\t" << region_code(region) << "\t" << method_code(method) << "\t";
+                    for(auto length : lengths) casal.length_file << length_sample(region, method, length) << "\t";
+                    casal.length_file << "\n";
+                }
+            }
+        }
+    }
+
+    /**
+     * Write population numbers, CPUEs and age and length samples as
+     * columnar files (see `Columnar`)
+     */
+    void columnar_write(const std::string& directory) {
+        Columnar numbers_file(directory + "/population_numbers.col", {columnar_years(), columnar_regions()});
+        Columnar cpues_file(directory + "/cpues.col", {columnar_years(), columnar_regions(), columnar_methods()});
+        Columnar ages_file(directory + "/age_samples.col", {columnar_years(), columnar_regions(), columnar_methods(), columnar_ages()});
+        Columnar lengths_file(directory + "/length_samples.col", {columnar_years(), columnar_regions(), columnar_methods(), columnar_lengths()});
+        for (auto year : years) {
+            for (auto region : regions) {
+                numbers_file.append({year.index(), region.index()}, population_numbers(year, region));
+                for (auto method : methods) {
+                    cpues_file.append({year.index(), region.index(), method.index()}, cpues(year, region, method));
+                    for (auto age : ages) {
+                        ages_file.append({year.index(), region.index(), method.index(), age.index()}, age_samples(year, region, method, age));
+                    }
+                    for (auto length : lengths) {
+                        lengths_file.append({year.index(), region.index(), method.index(), length.index()}, length_samples(year, region, method, length));
+                    }
+                }
+            }
+        }
+    }
 
 };  // class Monitor
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#if defined(SNA1_ZSTD)
+#include <zstd.h>
+#endif
+
+/**
+ * A stream buffer that writes to a file, optionally compressing on the fly
+ *
+ * @see Output
+ */
+class OutputBuffer : public std::streambuf {
+ public:
+
+    OutputBuffer(const std::string& path, char compression):
+        compression_(compression),
+        buffer_(1 << 16),
+        compressed_(1 << 16) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (not file_) throw std::runtime_error("Unable to open file: " + path);
+
+        if (compression_ == 'g') {
+            // Window bits of 15 + 16 for a gzip (rather than zlib) header
+            stream_.zalloc = Z_NULL;
+            stream_.zfree = Z_NULL;
+            stream_.opaque = Z_NULL;
+            if (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Unable to initialise gzip compression for: " + path);
+            }
+        } else if (compression_ == 'z') {
+            #if defined(SNA1_ZSTD)
+                context_ = ZSTD_createCCtx();
+                if (not context_) throw std::runtime_error("Unable to initialise zstd compression for: " + path);
+            #else
+                throw std::runtime_error("Not compiled with zstd compression (define SNA1_ZSTD and link with -lzstd)");
+            #endif
+        } else if (compression_ != 'n') {
+            throw std::runtime_error(std::string("Unknown output compression: ") + compression_);
+        }
+
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    ~OutputBuffer(void) {
+        try {
+            close();
+        } catch (...) {}
+    }
+
+    /**
+     * Write any remaining data, finish the compressed stream and close the file
+     */
+    void close(void) {
+        if (not file_) return;
+        drain(finish);
+        if (compression_ == 'g') deflateEnd(&stream_);
+        #if defined(SNA1_ZSTD)
+            if (compression_ == 'z') ZSTD_freeCCtx(context_);
+        #endif
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+ protected:
+
+    int_type overflow(int_type character) override {
+        drain(proceed);
+        if (not traits_type::eq_int_type(character, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(character);
+            pbump(1);
+        }
+        return traits_type::not_eof(character);
+    }
+
+    int sync(void) override {
+        if (not file_) return 0;
+        drain(flush);
+        std::fflush(file_);
+        return 0;
+    }
+
+ private:
+
+    char compression_;
+    std::FILE* file_ = nullptr;
+
+    /**
+     * Uncompressed data waiting to be written
+     */
+    std::vector<char> buffer_;
+
+    /**
+     * Compressed data
+     */
+    std::vector<char> compressed_;
+
+    z_stream stream_;
+    #if defined(SNA1_ZSTD)
+        ZSTD_CCtx* context_ = nullptr;
+    #endif
+
+    enum Mode {
+        proceed,
+        flush,
+        finish
+    };
+
+    void put(const char* data, std::size_t size) {
+        if (size and std::fwrite(data, 1, size, file_) != size) throw std::runtime_error("Error writing output file");
+    }
+
+    /**
+     * Compress (if necessary) and write buffered data
+     */
+    void drain(Mode mode) {
+        auto size = pptr() - pbase();
+        if (compression_ == 'n') {
+            put(pbase(), size);
+        } else if (compression_ == 'g') {
+            stream_.next_in = reinterpret_cast<Bytef*>(pbase());
+            stream_.avail_in = size;
+            int option = (mode == finish) ? Z_FINISH : ((mode == flush) ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            int result;
+            do {
+                stream_.next_out = reinterpret_cast<Bytef*>(compressed_.data());
+                stream_.avail_out = compressed_.size();
+                result = deflate(&stream_, option);
+                if (result == Z_STREAM_ERROR) throw std::runtime_error("Error compressing output file");
+                put(compressed_.data(), compressed_.size() - stream_.avail_out);
+            } while (stream_.avail_out == 0 or (mode == finish and result != Z_STREAM_END));
+        } else if (compression_ == 'z') {
+            #if defined(SNA1_ZSTD)
+                ZSTD_inBuffer input = {pbase(), std::size_t(size), 0};
+                auto directive = (mode == finish) ? ZSTD_e_end : ((mode == flush) ? ZSTD_e_flush : ZSTD_e_continue);
+                std::size_t remaining;
+                do {
+                    ZSTD_outBuffer output = {compressed_.data(), compressed_.size(), 0};
+                    remaining = ZSTD_compressStream2(context_, &output, &input, directive);
+                    if (ZSTD_isError(remaining)) throw std::runtime_error(std::string("Error compressing output file: ") + ZSTD_getErrorName(remaining));
+                    put(compressed_.data(), output.pos);
+                } while ((directive == ZSTD_e_continue) ? (input.pos < input.size) : (remaining != 0));
+            #endif
+        }
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+};
+
+
+/**
+ * An output file stream with optional streaming compression
+ *
+ * Used instead of `std::ofstream` for output files so that they can be compressed
+ * as they are written (e.g. to save disk space for ensembles), as selected by
+ * `Parameters::output_compression`:
+ *
+ *   n = none
+ *   g = gzip (`.gz` is appended to file names)
+ *   z = zstd (`.zst` is appended to file names; requires compiling with `SNA1_ZSTD`)
+ */
+class Output : public std::ostream {
+ public:
+
+    Output(void):
+        std::ostream(nullptr) {}
+
+    Output(const std::string& path, char compression = 'n'):
+        std::ostream(nullptr) {
+        open(path, compression);
+    }
+
+    ~Output(void) {
+        rdbuf(nullptr);
+    }
+
+    void open(const std::string& path, char compression = 'n') {
+        buffer_.reset(new OutputBuffer(Output::path(path, compression), compression));
+        rdbuf(buffer_.get());
+        clear();
+    }
+
+    bool is_open(void) const {
+        return buffer_ != nullptr;
+    }
+
+    void close(void) {
+        if (not buffer_) return;
+        buffer_->close();
+        rdbuf(nullptr);
+        buffer_.reset();
+    }
+
+    /**
+     * The path that a file is written to given the compression
+     */
+    static std::string path(const std::string& path, char compression) {
+        switch (compression) {
+            case 'n': return path;
+            case 'g': return path + ".gz";
+            case 'z': return path + ".zst";
+        }
+        throw std::runtime_error(std::string("Unknown output compression: ") + compression);
+    }
+
+    /**
+     * Write an array (e.g. a `Stencila::Array`) to a file
+     */
+    template<class Array>
+    static void write(const Array& array, const std::string& path, char compression) {
+        if (compression == 'n') {
+            array.write(path);
+        } else {
+            Output file(path, compression);
+            array.write(file);
+        }
+    }
+
+    /**
+     * Compress a file that has already been written (for files written
+     * by code that can only write to a path) and remove the original
+     */
+    static void compress(const std::string& path, char compression) {
+        if (compression == 'n') return;
+        {
+            std::ifstream input(path, std::ios::binary);
+            Output output(path, compression);
+            output << input.rdbuf();
+        }
+        std::remove(path.c_str());
+    }
+
+ private:
+    std::unique_ptr<OutputBuffer> buffer_;
+};
@@ -3,6 +3,7 @@
 #include "requirements.hpp"
 #include "random.hpp"
 #include "dimensions.hpp"
+#include "output.hpp"
 
 
 /**
@@ -40,9 +41,9 @@ class Parameters : public Structure<Parameters> {
     /**
      * Number of instances of `Fish` to seed the population with
      *
-     * Preliminary sensitity analyses (see `instances_seed_sensitivity` in `sna1.cpp`)
-     * suggested 100,000 was a good trade-off between run duration and precision at least
-     * during development. Should be increased for final runs.
+     * Preliminary sensitity analyses (see the `seed-sensitivity` task in `sna1.cpp`
+     * and `SeedSensitivity`) suggested 100,000 was a good trade-off between run duration
+     * and precision at least during development. Should be increased for final runs.
      */
     unsigned int fishes_seed_number = 1e6;
 
@@ -60,6 +61,83 @@ class Parameters : public Structure<Parameters> {
      */
     Exponential fishes_seed_age_dist;
 
+    /**
+     * Number of individuals represented by each instance of `Fish` at recruitment
+     *
+     * Values greater than 1 turn on "super-individuals": recruits enter as fewer
+     * instances each representing this many individuals (relative to `Fishes::scalar`).
+     * Natural mortality, harvest and tagging then decrement or split counts rather
+     * than killing whole instances. Tagged fish always represent a single individual.
+     */
+    unsigned int fishes_recruit_count = 1;
+
+    /**
+     * Age at which super-individuals are split into single individuals (0 = never)
+     *
+     * Reduces the number of instances in the young, abundant, age classes
+     * without losing resolution in the older ages.
+     */
+    unsigned int fishes_split_age = 0;
+
+    /**
+     * Maximum number of live instances of `Fish` (0 = no limit)
+     *
+     * When the number of live instances goes above this (e.g. because of high
+     * recruitment) the population is thinned back to `fishes_seed_number` by randomly
+     * retaining instances and increasing `Fishes::scalar` accordingly. Tagged fish are
+     * always retained.
+     */
+    unsigned int fishes_instances_max = 0;
+
+    /**
+     * Minimum number of live instances of `Fish` (0 = no limit)
+     *
+     * When the number of live instances goes below this (e.g. because the population
+     * collapses) instances are cloned to bring it back to `fishes_seed_number` and
+     * `Fishes::scalar` is decreased accordingly. Tagged fish are never cloned.
+     */
+    unsigned int fishes_instances_min = 0;
+
+    /**
+     * Type of burn in to pristine equilibrium
+     *
+     * i = individuals (the individual-based model is run for 100 years)
+     * c = cohorts (a `Cohorts` model is run to equilibrium and then individuals are sampled from it)
+     */
+    char fishes_burnin = 'i';
+
+    /**
+     * Type of memory pages for the population of `Fish` (see `Allocation`)
+     *
+     * n = normal
+     * t = transparent huge pages
+     * e = explicit huge pages
+     */
+    char fishes_pages = 'n';
+
+    /**
+     * Placement of the population of `Fish` across NUMA nodes (see `Allocation`)
+     *
+     * f = first touch
+     * i = interleaved
+     */
+    char fishes_placement = 'f';
+
+    /**
+     * Directory for a file backing the population of `Fish` (empty = in memory)
+     *
+     * For populations that do not fit in memory (see `Allocation`). Should be
+     * on a fast local disk.
+     */
+    std::string fishes_file = "";
+
+    /**
+     * Write population counts (`output/fishes/counts`) each year?
+     *
+     * See `Fishes::track()`
+     */
+    bool fishes_track = false;
+
     /**
      * Pristine spawner biomass (t)
      */
@@ -181,6 +259,16 @@ class Parameters : public Structure<Parameters> {
         25, 25, 25, 25
     };
 
+    /**
+     * Number of fish chosen from a block of the population before moving to another
+     * block when choosing fish at random for harvest and tag release (0 = choose each fish
+     * from the whole population)
+     *
+     * Keeps memory access (and page faults for file backed populations) localised. Blocks
+     * are chosen in proportion to their size so each fish is equally likely to be chosen overall.
+     */
+    unsigned int harvest_sampling_batch = 0;
+
     /**
      * Mortality of fish that are returned to sea
      */
@@ -223,6 +311,57 @@ class Parameters : public Structure<Parameters> {
      */
     double tagging_detection = 1;
 
+    /**
+     * Format of large output files (population counts and monitoring arrays)
+     *
+     * t = tab separated values
+     * c = sparse binary columns (see `Columnar`)
+     */
+    char output_format = 't';
+
+    /**
+     * Compression of output files
+     *
+     * n = none
+     * g = gzip (`.gz` is appended to file names)
+     * z = zstd (`.zst` is appended to file names; requires compiling with `SNA1_ZSTD`)
+     */
+    char output_compression = 'n';
+
+    /**
+     * Maximum size (MB) of the queue of outputs waiting to be written
+     * by a background thread (see `Writer`)
+     *
+     * If zero, outputs are written on the simulation thread.
+     */
+    unsigned int output_queue = 0;
+
+    /**
+     * Number of significant digits for floating point numbers in
+     * TSV outputs written by `Tsv` (the default is that of `std::ostream`)
+     */
+    int output_precision = 6;
+
+    /**
+     * Write monitoring outputs each year as the simulation proceeds?
+     *
+     * If true, in the `run` task, monitoring records are written each year by a
+     * `MonitorStream` rather than being retained until the end of the run.
+     */
+    bool monitor_stream = false;
+
+    /**
+     * Use common random numbers?
+     *
+     * If true, the random numbers used for natural processes (the attributes of
+     * fish at birth, survival, growth, maturation, movement and tag shedding) and
+     * for recruitment strengths are drawn from streams keyed on the identity of the fish
+     * (or region) and the year, rather than in the order in which draws are made.
+     * Scenarios run with the same seed then see the same "nature" so that differences
+     * between them can be detected with fewer replicates.
+     */
+    bool random_common = false;
+
     /**
      * Initialise parameters
      */
@@ -271,8 +410,24 @@ class Parameters : public Structure<Parameters> {
 
         #undef IFE
 
-        // Derived values
-        
+        update();
+    }
+
+    /**
+     * Update derived values
+     *
+     * Needs to be called if base values are changed after `initialise()`
+     * (e.g. for the design points of a `Sweep`)
+     */
+    void update(void) {
+        // Rescaling is back to `fishes_seed_number` so it must be within the limits
+        if (fishes_instances_min > 0 and fishes_instances_min > fishes_seed_number) {
+            throw std::runtime_error("fishes_instances_min must not be greater than fishes_seed_number");
+        }
+        if (fishes_instances_max > 0 and fishes_instances_max < fishes_seed_number) {
+            throw std::runtime_error("fishes_instances_max must not be less than fishes_seed_number");
+        }
+
         fishes_seed_region_dist = Uniform(0,3);
         fishes_seed_age_dist = Exponential(fishes_seed_z);
 
@@ -287,16 +442,18 @@ class Parameters : public Structure<Parameters> {
     void finalise(void) {
         boost::filesystem::create_directories("output");
 
+        auto compression = output_compression;
         write("output/parameters.json");
-        fishes_b0.write("output/fishes_b0.tsv");
-        fishes_rec_strengths.write("output/fishes_rec_strengths.tsv");
-        fishes_movement.write("output/fishes_movement.tsv");
-        fishes_shyness.write("output/fishes_shyness.tsv");
-        harvest_mls.write("output/harvest_mls.tsv");
-        harvest_catch_history.write("output/harvest_catch_history.tsv");
-        monitoring_programme.write("output/monitoring_programme.tsv");
-        tagging_releases.write("output/tagging_releases.tsv");
-        tagging_scanning.write("output/tagging_scanning.tsv");
+        Output::compress("output/parameters.json", compression);
+        Output::write(fishes_b0, "output/fishes_b0.tsv", compression);
+        Output::write(fishes_rec_strengths, "output/fishes_rec_strengths.tsv", compression);
+        Output::write(fishes_movement, "output/fishes_movement.tsv", compression);
+        Output::write(fishes_shyness, "output/fishes_shyness.tsv", compression);
+        Output::write(harvest_mls, "output/harvest_mls.tsv", compression);
+        Output::write(harvest_catch_history, "output/harvest_catch_history.tsv", compression);
+        Output::write(monitoring_programme, "output/monitoring_programme.tsv", compression);
+        Output::write(tagging_releases, "output/tagging_releases.tsv", compression);
+        Output::write(tagging_scanning, "output/tagging_scanning.tsv", compression);
     }
 
     template<class Mirror>
@@ -304,6 +461,15 @@ class Parameters : public Structure<Parameters> {
         mirror
             .data(fishes_seed_number, "fishes_seed_number")
             .data(fishes_seed_z, "fishes_seed_z")
+            .data(fishes_recruit_count, "fishes_recruit_count")
+            .data(fishes_split_age, "fishes_split_age")
+            .data(fishes_instances_max, "fishes_instances_max")
+            .data(fishes_instances_min, "fishes_instances_min")
+            .data(fishes_burnin, "fishes_burnin")
+            .data(fishes_pages, "fishes_pages")
+            .data(fishes_placement, "fishes_placement")
+            .data(fishes_file, "fishes_file")
+            .data(fishes_track, "fishes_track")
             
             .data(fishes_steepness, "fishes_steepness")
             .data(fishes_rec_var, "fishes_rec_var")
@@ -327,14 +493,21 @@ class Parameters : public Structure<Parameters> {
 
             .data(fishes_movement_type, "fishes_movement_type")
             
+            .data(harvest_sampling_batch, "harvest_sampling_batch")
             .data(harvest_handling_mortality, "harvest_handling_mortality")
 
             .data(tagging_mortality, "tagging_mortality")
             .data(tagging_shedding, "tagging_shedding")
             .data(tagging_detection, "tagging_detection")
+
+            .data(random_common, "random_common")
+
+            .data(output_format, "output_format")
+            .data(output_compression, "output_compression")
+            .data(output_queue, "output_queue")
+            .data(output_precision, "output_precision")
+            .data(monitor_stream, "monitor_stream")
         ;
     }
 
 };  // class Parameters
-
-Parameters parameters;
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A work-stealing thread pool
+ *
+ * Each worker has its own queue of tasks. Workers take tasks from the back of
+ * their own queue and, when that is empty, steal from the front of other
+ * workers' queues. Used for running independent simulations (e.g. ensemble
+ * replicates) concurrently in the one process.
+ */
+class Pool {
+ public:
+
+    typedef std::function<void()> Task;
+
+    /**
+     * Create a pool
+     *
+     * @param threads Number of worker threads (defaults to the number of cores)
+     */
+    Pool(unsigned int threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        queues_ = std::vector<Queue>(threads);
+        for (unsigned int index = 0; index < threads; index++) {
+            workers_.emplace_back([this, index](){ work(index); });
+        }
+    }
+
+    ~Pool(void) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        available_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    /**
+     * Number of worker threads
+     */
+    unsigned int size(void) const {
+        return workers_.size();
+    }
+
+    /**
+     * Submit a task to the pool
+     *
+     * Tasks are distributed across worker queues in round-robin order
+     */
+    void submit(Task task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_++;
+        }
+        auto& queue = queues_[next_++ % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        available_.notify_one();
+    }
+
+    /**
+     * Wait until all submitted tasks have finished
+     *
+     * If any task threw an exception, the first one is rethrown here.
+     */
+    void wait(void) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [this](){ return pending_ == 0; });
+        if (error_) {
+            auto error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+ private:
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<unsigned int> next_{0};
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::condition_variable finished_;
+    unsigned int pending_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    /**
+     * Get a task, first from the worker's own queue and then
+     * by stealing from the other queues
+     */
+    bool take(unsigned int index, Task& task) {
+        {
+            auto& own = queues_[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.tasks.size()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned int offset = 1; offset < queues_.size(); offset++) {
+            auto& other = queues_[(index + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (other.tasks.size()) {
+                task = std::move(other.tasks.front());
+                other.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(unsigned int index) {
+        while (true) {
+            Task task;
+            if (take(index, task)) {
+                std::exception_ptr error;
+                try {
+                    task();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error and not error_) error_ = error;
+                if (--pending_ == 0) finished_.notify_all();
+            } else {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (stop_) return;
+                // Wait briefly for more work; the timeout guards against a task
+                // being queued between `take()` failing and this wait starting
+                available_.wait_for(lock, std::chrono::milliseconds(10));
+                if (stop_) return;
+            }
+        }
+    }
+
+};  // class Pool
@@ -1,37 +1,135 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <ctime>
 
 #include <boost/random/mersenne_twister.hpp>
-#include <boost/random/variate_generator.hpp>
 #include <boost/random/uniform_01.hpp>
 #include <boost/random/uniform_real.hpp>
+#include <boost/random/normal_distribution.hpp>
 #include <boost/random/lognormal_distribution.hpp>
 #include <boost/random/exponential_distribution.hpp>
+#include <boost/random/binomial_distribution.hpp>
 
 /**
+ * A random number generator
+ *
  * The mt11213b generator is fast and has a reasonable cycle length
  * See http://www.boost.org/doc/libs/1_60_0/doc/html/boost_random/reference.html#boost_random.reference.generators
+ *
+ * Each simulation `Context` owns one of these so that concurrent simulations
+ * do not share (or race on) generator state.
  */
-struct random_generator : boost::mt11213b {
-    random_generator(void){
-        seed(static_cast<unsigned int>(std::time(0)));
+class Random : public boost::mt11213b {
+ public:
+
+    /**
+     * Seed from the current time
+     *
+     * The time is combined with a count of the generators created so that
+     * generators created within the same second get different seeds.
+     */
+    Random(void) {
+        static std::atomic<unsigned int> count(0);
+        seed(static_cast<unsigned int>(std::time(0)) + 7919 * count++);
+    }
+
+    /**
+     * Seed with a specific value (e.g. for reproducible replicates)
+     */
+    Random(unsigned int value) {
+        seed(value);
+    }
+
+    /**
+     * Get a uniform random number in [0, 1)
+     */
+    double chance(void) {
+        return chance_distr(*this);
     }
-} random_generator;
+
+    /**
+     * Get a random number from the standard normal distribution
+     */
+    double standard_normal(void) {
+        return standard_normal_distr(*this);
+    }
+
+ private:
+    boost::uniform_01<> chance_distr;
+    boost::normal_distribution<> standard_normal_distr = boost::normal_distribution<>(0, 1);
+};
+
+
+/**
+ * A keyed random number stream
+ *
+ * A counter-based generator (SplitMix64) whose sequence is determined entirely
+ * by a key. Keys are made by hashing together things like the identity of a fish,
+ * the time and the process that the numbers are for. That means the numbers drawn
+ * for those things do not depend on the order in which other draws were made.
+ */
+class Stream {
+ public:
+
+    typedef uint32_t result_type;
+
+    Stream(uint64_t key):
+        state_(key) {}
+
+    static constexpr result_type min(void) {
+        return 0;
+    }
+
+    static constexpr result_type max(void) {
+        return 0xFFFFFFFF;
+    }
+
+    result_type operator()(void) {
+        state_ += 0x9E3779B97F4A7C15ull;
+        return static_cast<result_type>(mix(state_) >> 32);
+    }
+
+    /**
+     * Make a key by hashing together values
+     */
+    static uint64_t key(uint64_t value) {
+        return mix(value);
+    }
+
+    template<class... Values>
+    static uint64_t key(uint64_t value, Values... values) {
+        return mix(value ^ key(values...));
+    }
+
+ private:
+
+    uint64_t state_;
+
+    /**
+     * The SplitMix64 finaliser
+     */
+    static uint64_t mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+};
 
 
 template<
 	class Type
 > struct Distribution {
 	Type distribution;
-	boost::variate_generator<decltype(random_generator),Type> variate_generator;
 
 	template<class... Args>
 	Distribution(Args... args):
-		variate_generator(random_generator,Type(args...)) {}
+		distribution(args...) {}
 
-    double random(void) {
-    	return variate_generator();
+    template<class Generator>
+    double random(Generator& generator) {
+    	return distribution(generator);
     }
 };
 
@@ -41,14 +139,3 @@ typedef Distribution< boost::uniform_real<> > Uniform;
 typedef Distribution< boost::exponential_distribution<> > Exponential;
 typedef Distribution< boost::normal_distribution<> > Normal;
 typedef Distribution< boost::lognormal_distribution<> > Lognormal;
-
-
-Uniform01 chance_distr;
-double chance(void){
-	return chance_distr.random();
-}
-
-Normal standard_normal_distr = {0, 1};
-double standard_normal_rand(void){
-	return standard_normal_distr.random();
-}
\ No newline at end of file
@@ -5,10 +5,12 @@
 #pragma once
 
 // C/C++ standard library
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <thread>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <string>
 
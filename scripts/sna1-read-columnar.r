@@ -0,0 +1,60 @@
+# Read a sparse binary columnar file (see `Columnar` in `columnar.hpp`)
+# e.g. counts <- read_columnar('../output/fishes/counts.col')
+#
+# Returns a data frame with a column for each dimension (a factor if the
+# dimension has labels) and a column of values. Cells not in the file are zero;
+# use `dense = TRUE` to include them.
+
+read_columnar <- function(path, dense = FALSE) {
+  con <- file(path, 'rb')
+  on.exit(close(con))
+
+  int <- function(n = 1) readBin(con, 'integer', n = n, size = 4, endian = 'little')
+  string <- function() {
+    n <- int()
+    if (n == 0) '' else readChar(con, n, useBytes = TRUE)
+  }
+
+  if (readChar(con, 8, useBytes = TRUE) != 'SNA1COLS') stop('Not a columnar file: ', path)
+  version <- int()
+
+  dimensions <- int()
+  names <- character(dimensions)
+  labels <- vector('list', dimensions)
+  for (dimension in seq_len(dimensions)) {
+    names[dimension] <- string()
+    labels[[dimension]] <- vapply(seq_len(int()), function(i) string(), '')
+  }
+  value <- string()
+
+  levels <- rep(list(integer(0)), dimensions)
+  values <- numeric(0)
+  repeat {
+    rows <- int()
+    if (length(rows) == 0) break
+    for (dimension in seq_len(dimensions)) {
+      levels[[dimension]] <- c(levels[[dimension]], readBin(con, 'integer', n = rows, size = 2, signed = FALSE, endian = 'little'))
+    }
+    values <- c(values, readBin(con, 'double', n = rows, size = 8, endian = 'little'))
+  }
+
+  columns <- lapply(seq_len(dimensions), function(dimension) {
+    if (length(labels[[dimension]]) == 0) levels[[dimension]]
+    else factor(labels[[dimension]][levels[[dimension]] + 1], levels = labels[[dimension]])
+  })
+  names(columns) <- names
+  data <- as.data.frame(columns)
+  data[[value]] <- values
+
+  if (dense) {
+    grid <- expand.grid(lapply(seq_len(dimensions), function(dimension) {
+      if (length(labels[[dimension]]) == 0) sort(unique(levels[[dimension]]))
+      else factor(labels[[dimension]], levels = labels[[dimension]])
+    }))
+    names(grid) <- names
+    data <- merge(grid, data, all.x = TRUE)
+    data[[value]][is.na(data[[value]])] <- 0
+  }
+
+  data
+}
@@ -0,0 +1,61 @@
+# Read a binary tag archive (see `TagArchive` in `tag-archive.hpp`)
+# e.g. tags <- read_tags('../output/monitor/tagging/tags.bin', years = 2000:2005)
+#
+# Returns a data frame with a row for each tag released in `years` (all
+# years if NULL) with the same fields as `recaptures.tsv` (`time_rec` is
+# zero for tags that have not been recaptured). Only the rows for those
+# years are read from the file. Use `recaptured = TRUE` to only return
+# recaptured tags.
+
+read_tags <- function(path, years = NULL, recaptured = FALSE) {
+  con <- file(path, 'rb')
+  on.exit(close(con))
+
+  int <- function(n = 1) readBin(con, 'integer', n = n, size = 4, endian = 'little')
+
+  if (readChar(con, 8, useBytes = TRUE) != 'SNA1TAGS') stop('Not a tag archive: ', path)
+  version <- int()
+  rows <- int()
+  year_min <- int()
+  year_count <- int()
+  region_count <- int()
+  recaptures <- int()
+  release_index <- int(year_count * region_count + 1)
+
+  # Rows are ordered by release year so those for a range of years are contiguous
+  if (is.null(years)) years <- year_min + seq_len(year_count) - 1
+  years <- pmin(pmax(years, year_min), year_min + year_count - 1)
+  begin <- release_index[(min(years) - year_min) * region_count + 1]
+  end <- release_index[(max(years) - year_min + 1) * region_count + 1]
+  n <- end - begin
+
+  columns <- 8 + 4 * 6 + 4 * (length(release_index) + year_count + 1 + recaptures)
+  column <- function(offset, what, size, ...) {
+    seek(con, columns + offset + begin * size)
+    readBin(con, what, n = n, size = size, endian = 'little', ...)
+  }
+  event <- function(offset) {
+    list(
+      time = column(offset, 'integer', 2, signed = FALSE),
+      region = column(offset + rows * 2, 'integer', 1, signed = FALSE),
+      method = column(offset + rows * 3, 'integer', 1, signed = FALSE),
+      length = column(offset + rows * 4, 'double', 4)
+    )
+  }
+  tag <- column(0, 'integer', 4)
+  rel <- event(rows * 4)
+  rec <- event(rows * 12)
+
+  regions <- c('EN', 'HG', 'BP')
+  methods <- c('LL', 'BT', 'DS', 'RE')
+  data <- data.frame(
+    tag = tag,
+    time_rel = rel$time, time_rec = rec$time,
+    region_rel = regions[rel$region + 1], region_rec = regions[rec$region + 1],
+    method_rel = methods[rel$method + 1], method_rec = methods[rec$method + 1],
+    length_rel = rel$length, length_rec = rec$length
+  )
+  data <- data[data$time_rel %in% years, ]
+  if (recaptured) data <- data[data$time_rec > 0, ]
+  data
+}
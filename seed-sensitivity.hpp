@@ -0,0 +1,192 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+#include "model.hpp"
+#include "pool.hpp"
+#include "summary.hpp"
+
+/**
+ * Sensitivity of run duration, memory use and precision to the
+ * number of instances of `Fish` (`fishes_seed_number`)
+ *
+ * For each seed number in a grid, runs replicates concurrently on a `Pool`
+ * and records their duration and outputs. The results can be used to choose
+ * a seed number that is a good trade-off between cost and precision
+ * (see `scripts/sna1-instances-seed-sensitivity.r`). Outputs are written to
+ * `output/instances_seed_sensitivity*.tsv`.
+ */
+class SeedSensitivity {
+ public:
+
+    /**
+     * Grid of seed numbers
+     *
+     * Seed numbers are run in the order given. Because peak memory use
+     * can only increase, this should be in ascending order.
+     */
+    std::vector<unsigned int> seed_numbers = {10000, 30000, 100000, 300000, 1000000};
+
+    /**
+     * Number of replicates for each seed number
+     */
+    unsigned int replicates = 10;
+
+    /**
+     * Number of threads to use (0 = number of cores)
+     */
+    unsigned int threads = 0;
+
+    /**
+     * Base random seed; replicate `r` is seeded with `seed + r`
+     */
+    unsigned int seed = std::time(0);
+
+    /**
+     * Time period for each replicate
+     */
+    Time start = 1900;
+    Time finish = 2018;
+
+    /**
+     * Run the sensitivity analysis
+     *
+     * @param parameters Parameters shared by all replicates (other than `fishes_seed_number`)
+     */
+    void run(const Parameters& parameters) {
+        boost::filesystem::create_directories("output");
+
+        // Files are written without headers for compatibility with
+        // `scripts/sna1-instances-seed-sensitivity.r`
+        auto compression = parameters.output_compression;
+        data_file_.open("output/instances_seed_sensitivity.tsv", compression);
+        times_file_.open("output/instances_seed_sensitivity_times.tsv", compression);
+
+        Output summary_file("output/instances_seed_sensitivity_summary.tsv", compression);
+        summary_file
+            << "seed\treplicates\tduration_mean\tduration_sd\tfishes_mb\trss_peak_mb\t"
+            << "biomass_spawner_mean\tbiomass_spawner_cv\tlength_mean_mean\tlength_mean_cv\n";
+
+        Pool pool(threads);
+        for (auto seed_number : seed_numbers) {
+            Parameters level = parameters;
+            level.fishes_seed_number = seed_number;
+            // Validate and derive parameters for this seed number
+            level.update();
+
+            duration_ = Moments();
+            biomass_spawner_ = Moments();
+            length_mean_ = Moments();
+            fishes_bytes_ = 0;
+
+            for (unsigned int replicate = 0; replicate < replicates; replicate++) {
+                pool.submit([this, &level, seed_number, replicate](){
+                    replicate_run(level, seed_number, replicate);
+                });
+            }
+            pool.wait();
+
+            summary_file
+                << seed_number << "\t"
+                << replicates << "\t"
+                << duration_.mean() << "\t"
+                << duration_.sd() << "\t"
+                << fishes_bytes_/1e6 << "\t"
+                << rss_peak()/1e6 << "\t"
+                << biomass_spawner_.mean() << "\t"
+                << biomass_spawner_.sd()/biomass_spawner_.mean() << "\t"
+                << length_mean_.mean() << "\t"
+                << length_mean_.sd()/length_mean_.mean() << std::endl;
+
+            std::cout << "seed number " << seed_number << " finished" << std::endl;
+        }
+
+        data_file_.close();
+        times_file_.close();
+    }
+
+ private:
+
+    std::mutex mutex_;
+    Output data_file_;
+    Output times_file_;
+
+    /**
+     * Moments of duration and final year outputs for the current seed number
+     */
+    Moments duration_;
+    Moments biomass_spawner_;
+    Moments length_mean_;
+
+    /**
+     * Maximum memory used by `Fishes` in a replicate
+     */
+    double fishes_bytes_;
+
+    /**
+     * Run a replicate and record its outputs
+     */
+    void replicate_run(const Parameters& parameters, unsigned int seed_number, unsigned int replicate) {
+        auto began = std::chrono::steady_clock::now();
+
+        std::unique_ptr<Model> model(new Model);
+        model->context.seed(seed + replicate);
+        model->initialise(parameters);
+
+        // Record total spawning biomass and mean length in each year
+        std::vector<Time> times;
+        std::vector<double> biomass_spawners;
+        std::vector<double> length_means;
+        std::function<void()> callback([&](){
+            if (year(model->context.now) >= start) {
+                times.push_back(model->context.now);
+                biomass_spawners.push_back(sum(model->fishes.biomass_spawners));
+                length_means.push_back(model->fishes.length_mean());
+            }
+        });
+        model->run(start, finish, &callback);
+
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - began;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (unsigned int index = 0; index < times.size(); index++) {
+            data_file_
+                << seed_number << "\t"
+                << replicate << "\t"
+                << times[index] << "\t"
+                << biomass_spawners[index] << "\t"
+                << length_means[index] << "\n";
+        }
+        times_file_ << seed_number << "\t" << replicate << "\t" << duration.count() << "\n";
+
+        duration_.append(duration.count());
+        if (times.size()) {
+            biomass_spawner_.append(biomass_spawners.back());
+            length_mean_.append(length_means.back());
+        }
+        fishes_bytes_ = std::max<double>(fishes_bytes_, model->fishes.capacity() * sizeof(Fish));
+    }
+
+    /**
+     * Get the peak resident set size of the process (bytes)
+     *
+     * Note that this is for the whole process (i.e. for all concurrent
+     * replicates) and can only increase. Returns zero if not available.
+     */
+    static double rss_peak(void) {
+        #if defined(__unix__)
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_maxrss * 1024.0;
+        #else
+            return 0;
+        #endif
+    }
+
+};  // class SeedSensitivity
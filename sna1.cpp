@@ -1,4 +1,9 @@
-#include "model.hpp"
+#include "ensemble.hpp"
+#include "harvest-benchmark.hpp"
+#include "lockstep.hpp"
+#include "monitor-stream.hpp"
+#include "seed-sensitivity.hpp"
+#include "sweep.hpp"
 
 int main(int argc, char** argv) {
     Model model;
@@ -14,14 +19,76 @@ int main(int argc, char** argv) {
             std::cout << std::setprecision(2);
             std::function<void()> callback([&](){
                 std::cout
-                    << now << "\t"
+                    << model.context.now << "\t"
                     << model.fishes.number(false)/1e6 << "\t" 
-                    << sum(model.fishes.biomass_spawners)/sum(parameters.fishes_b0) << "\t" 
+                    << sum(model.fishes.biomass_spawners)/sum(model.context.parameters.fishes_b0) << "\t" 
                     << sum(model.harvest.catch_taken)/sum(model.harvest.biomass_vulnerable) << std::endl; 
             });
+            if (model.context.parameters.monitor_stream) {
+                model.monitor.stream(std::make_shared<MonitorStream>(model.context.parameters));
+            }
             model.run(1900, 2018, &callback);
+        } else if (task == "ensemble") {
+            // Usage: sna1.exe ensemble [replicates] [threads] [seed]
+            Ensemble ensemble;
+            ensemble.progress = true;
+            ensemble.initialise();
+            if (argc >= 3) ensemble.replicates = std::stoi(argv[2]);
+            if (argc >= 4) ensemble.threads = std::stoi(argv[3]);
+            if (argc >= 5) ensemble.seed = std::stoul(argv[4]);
+            ensemble.run(model.context.parameters);
+            // Only output parameters; the other outputs of `model` are
+            // not meaningful because it was not run
+            model.context.parameters.finalise();
+            return 0;
+        } else if (task == "seed-sensitivity") {
+            // Usage: sna1.exe seed-sensitivity [replicates] [threads] [seed number]...
+            SeedSensitivity sensitivity;
+            if (argc >= 3) sensitivity.replicates = std::stoi(argv[2]);
+            if (argc >= 4) sensitivity.threads = std::stoi(argv[3]);
+            if (argc >= 5) {
+                sensitivity.seed_numbers.clear();
+                for (int arg = 4; arg < argc; arg++) sensitivity.seed_numbers.push_back(std::stoul(argv[arg]));
+            }
+            sensitivity.run(model.context.parameters);
+            return 0;
+        } else if (task == "sweep") {
+            // Usage: sna1.exe sweep [points] [threads] [seed]
+            Sweep sweep;
+            sweep.initialise();
+            if (argc >= 3) sweep.points = std::stoi(argv[2]);
+            if (argc >= 4) sweep.threads = std::stoi(argv[3]);
+            if (argc >= 5) sweep.seed = std::stoul(argv[4]);
+            sweep.run(model.context.parameters);
+            return 0;
+        } else if (task == "lockstep") {
+            // Usage: sna1.exe lockstep [seed]
+            Lockstep lockstep;
+            lockstep.add("base", model.context.parameters);
+            lockstep.read(model.context.parameters);
+            if (argc >= 3) lockstep.seed(std::stoul(argv[2]));
+            lockstep.run(1900, 2018);
+            lockstep.finalise();
+            return 0;
+        } else if (task == "cohorts") {
+            // Usage: sna1.exe cohorts [survival mode] [seed]
+            Cohorts cohorts;
+            cohorts.initialise(model.context.parameters);
+            if (argc >= 3) cohorts.survival_mode = argv[2][0];
+            if (argc >= 4) cohorts.context.seed(std::stoul(argv[3]));
+            cohorts.run(1900, 2018);
+            cohorts.finalise();
+            return 0;
+        } else if (task == "harvest-benchmark") {
+            // Usage: sna1.exe harvest-benchmark [instances] [repeats] [allocation]...
+            HarvestBenchmark benchmark;
+            if (argc >= 3) benchmark.instances = std::stoul(argv[2]);
+            if (argc >= 4) benchmark.repeats = std::stoi(argv[3]);
+            if (argc >= 5) benchmark.allocations = std::vector<std::string>(argv + 4, argv + argc);
+            benchmark.run(model.context.parameters);
+            return 0;
         } else {
-            std::cout << "No task (e.g. run) specified" <<std::endl;
+            std::cout << "No task (e.g. run, ensemble, seed-sensitivity, sweep, lockstep, cohorts, harvest-benchmark) specified" <<std::endl;
         }
     } catch(std::exception& error) {
         std::cout << "************Error************\n"
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "dimensions.hpp"
+
+/**
+ * Sparse storage of an array by year, region, method and bin (e.g. age or length)
+ *
+ * Monitoring samples (e.g. `Monitor::length_samples`) are only taken in some years
+ * and for some regions and methods, so a dense `Array<Type, Years, Regions, Methods, Bins>`
+ * is mostly zeros. This stores a slice of bins only for each year, region and method that
+ * has been set (a table of pointers to slices is the only cost of cells that have not).
+ * Reading an unset cell gives zero and `write()` gives the same output as the dense array.
+ */
+template<class Type, class Bins>
+class Sparse {
+ public:
+
+    /**
+     * The values of bins for a year, region and method
+     */
+    typedef Array<Type, Bins> Slice;
+
+    /**
+     * The equivalent dense array
+     */
+    typedef Array<Type, Years, Regions, Methods, Bins> Dense;
+
+    Sparse(void):
+        slices_(Years::size() * Regions::size() * Methods::size()) {}
+
+    Sparse(const Sparse& other):
+        Sparse() {
+        *this = other;
+    }
+
+    Sparse& operator=(const Sparse& other) {
+        for (unsigned int index = 0; index < slices_.size(); index++) {
+            const auto& slice = other.slices_[index];
+            slices_[index].reset(slice ? new Slice(*slice) : nullptr);
+        }
+        return *this;
+    }
+
+    /**
+     * Get the value of a cell (zero if its slice has not been set)
+     */
+    Type operator()(unsigned int year, unsigned int region, unsigned int method, unsigned int bin) const {
+        const auto& slice = slices_[offset(year, region, method)];
+        return slice ? (*slice)(bin) : Type(0);
+    }
+
+    /**
+     * Get the slice for a year, region and method (`nullptr` if it has not been set)
+     */
+    const Slice* find(unsigned int year, unsigned int region, unsigned int method) const {
+        return slices_[offset(year, region, method)].get();
+    }
+
+    /**
+     * Get the slice for a year, region and method, creating it (with all
+     * values zero) if necessary
+     */
+    Slice& slice(unsigned int year, unsigned int region, unsigned int method) {
+        auto& slice = slices_[offset(year, region, method)];
+        if (not slice) slice.reset(new Slice(Type(0)));
+        return *slice;
+    }
+
+    /**
+     * Set the slice for a year, region and method to the values in the current sample
+     * (by region, method and bin) unless they are all zero
+     */
+    template<class Sample>
+    void set(unsigned int year, unsigned int region, unsigned int method, const Sample& sample) {
+        bool any = false;
+        for (auto bin : Bins()) {
+            if (sample(region, method, bin) != 0) {
+                any = true;
+                break;
+            }
+        }
+        if (not any) {
+            slices_[offset(year, region, method)].reset();
+            return;
+        }
+        auto& values = slice(year, region, method);
+        for (auto bin : Bins()) values(bin) = sample(region, method, bin);
+    }
+
+    /**
+     * Number of slices that have been set
+     */
+    unsigned int slices(void) const {
+        unsigned int count = 0;
+        for (const auto& slice : slices_) if (slice) count++;
+        return count;
+    }
+
+    /**
+     * Remove all slices (i.e. set all values to zero)
+     */
+    void clear(void) {
+        for (auto& slice : slices_) slice.reset();
+    }
+
+    /**
+     * Create the equivalent dense array
+     */
+    std::unique_ptr<Dense> dense(void) const {
+        std::unique_ptr<Dense> dense(new Dense(Type(0)));
+        for (auto year : years) {
+            for (auto region : regions) {
+                for (auto method : methods) {
+                    auto slice = find(year, region.index(), method.index());
+                    if (not slice) continue;
+                    for (auto bin : Bins()) (*dense)(year, region, method, bin) = (*slice)(bin);
+                }
+            }
+        }
+        return dense;
+    }
+
+    void write(std::ostream& stream) const {
+        dense()->write(stream);
+    }
+
+    void write(const std::string& path) const {
+        dense()->write(path);
+    }
+
+ private:
+
+    std::vector<std::unique_ptr<Slice>> slices_;
+
+    static unsigned int offset(unsigned int year, unsigned int region, unsigned int method) {
+        return ((year - Years_min) * Regions::size() + region) * Methods::size() + method;
+    }
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Running moments of a variable
+ *
+ * Uses Welford's online algorithm so that the mean and variance can be
+ * updated one value at a time without storing the values. Two sets
+ * of moments can be merged (e.g. those accumulated on different threads).
+ */
+class Moments {
+ public:
+
+    /**
+     * Add a value
+     */
+    void append(double value) {
+        count_++;
+        double delta = value - mean_;
+        mean_ += delta/count_;
+        m2_ += delta * (value - mean_);
+    }
+
+    /**
+     * Merge another set of moments into this one
+     */
+    void merge(const Moments& other) {
+        if (other.count_ == 0) return;
+        double count = count_ + other.count_;
+        double delta = other.mean_ - mean_;
+        mean_ += delta * other.count_/count;
+        m2_ += other.m2_ + delta * delta * count_ * other.count_/count;
+        count_ = count;
+    }
+
+    double count(void) const {
+        return count_;
+    }
+
+    double mean(void) const {
+        return mean_;
+    }
+
+    /**
+     * Sample variance
+     */
+    double variance(void) const {
+        return (count_ > 1) ? m2_/(count_ - 1) : 0;
+    }
+
+    double sd(void) const {
+        return std::sqrt(variance());
+    }
+
+    /**
+     * Standard error of the mean
+     */
+    double se(void) const {
+        return (count_ > 0) ? std::sqrt(variance()/count_) : 0;
+    }
+
+ private:
+    double count_ = 0;
+    double mean_ = 0;
+    double m2_ = 0;
+};  // class Moments
+
+
+/**
+ * A mergeable sketch of the distribution of a variable for estimating quantiles
+ *
+ * A "merging t-digest" (Dunning & Ertl 2019): values are summarised as weighted
+ * centroids which are kept small near the tails of the distribution (where
+ * precision matters for intervals) and larger near the median. The number of
+ * centroids is bounded by `compression` so memory does not grow with the number of
+ * values appended. Sketches can be merged.
+ */
+class Sketch {
+ public:
+
+    Sketch(double compression = 100):
+        compression_(compression) {}
+
+    /**
+     * Add a value
+     */
+    void append(double value, double weight = 1) {
+        buffer_.push_back({value, weight});
+        count_ += weight;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        if (buffer_.size() >= 2 * compression_) compress();
+    }
+
+    /**
+     * Merge another sketch into this one
+     */
+    void merge(const Sketch& other) {
+        for (const auto& centroid : other.centroids_) buffer_.push_back(centroid);
+        for (const auto& centroid : other.buffer_) buffer_.push_back(centroid);
+        count_ += other.count_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        compress();
+    }
+
+    /**
+     * Total weight of values appended
+     */
+    double count(void) const {
+        return count_;
+    }
+
+    /**
+     * Estimate a quantile
+     *
+     * @param q Probability in [0, 1]
+     */
+    double quantile(double q) {
+        compress();
+        if (centroids_.empty()) return std::numeric_limits<double>::quiet_NaN();
+        if (centroids_.size() == 1) return centroids_[0].mean;
+
+        // Position of the quantile in cumulative weight. Each centroid is treated
+        // as being centred on the middle of its weight and values are linearly
+        // interpolated between centroids (and the minimum and maximum at the ends)
+        double position = q * count_;
+        double cumulative = 0;
+        double previous_centre = 0;
+        double previous_mean = min_;
+        for (const auto& centroid : centroids_) {
+            double centre = cumulative + centroid.weight/2;
+            if (position < centre) {
+                double fraction = (centre > previous_centre) ? (position - previous_centre)/(centre - previous_centre) : 0;
+                return previous_mean + fraction * (centroid.mean - previous_mean);
+            }
+            cumulative += centroid.weight;
+            previous_centre = centre;
+            previous_mean = centroid.mean;
+        }
+        double fraction = (count_ > previous_centre) ? (position - previous_centre)/(count_ - previous_centre) : 0;
+        return previous_mean + fraction * (max_ - previous_mean);
+    }
+
+ private:
+
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    double compression_;
+    double count_ = 0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    std::vector<Centroid> centroids_;
+    std::vector<Centroid> buffer_;
+
+    /**
+     * Scale function (and its inverse) that determines the maximum
+     * size of centroids
+     */
+    double scale(double q) const {
+        return compression_/(2*pi) * std::asin(2*q - 1);
+    }
+
+    double scale_inverse(double k) const {
+        return (std::sin(std::min(k*2*pi/compression_, pi/2)) + 1)/2;
+    }
+
+    static constexpr double pi = 3.14159265358979323846;
+
+    /**
+     * Merge the buffer into the centroids
+     */
+    void compress(void) {
+        if (buffer_.empty()) return;
+
+        for (const auto& centroid : centroids_) buffer_.push_back(centroid);
+        std::sort(buffer_.begin(), buffer_.end(), [](const Centroid& a, const Centroid& b){
+            return a.mean < b.mean;
+        });
+
+        centroids_.clear();
+        double total = 0;
+        for (const auto& centroid : buffer_) total += centroid.weight;
+
+        Centroid current = buffer_[0];
+        double so_far = 0;
+        double limit = total * scale_inverse(scale(0) + 1);
+        for (unsigned int index = 1; index < buffer_.size(); index++) {
+            const auto& next = buffer_[index];
+            if (so_far + current.weight + next.weight <= limit) {
+                current.mean += (next.mean - current.mean) * next.weight/(current.weight + next.weight);
+                current.weight += next.weight;
+            } else {
+                so_far += current.weight;
+                centroids_.push_back(current);
+                limit = total * scale_inverse(scale(so_far/total) + 1);
+                current = next;
+            }
+        }
+        centroids_.push_back(current);
+
+        buffer_.clear();
+    }
+
+};  // class Sketch
+
+
+/**
+ * A summary of the distribution of a variable across ensemble members
+ *
+ * Combines `Moments` and a `Sketch` so that mean, standard deviation
+ * and quantiles can be reported without storing each value.
+ */
+class Summary {
+ public:
+
+    Moments moments;
+    Sketch sketch;
+
+    void append(double value) {
+        moments.append(value);
+        sketch.append(value);
+    }
+
+    void merge(const Summary& other) {
+        moments.merge(other.moments);
+        sketch.merge(other.sketch);
+    }
+
+    /**
+     * Header for the columns written by `write()`
+     */
+    static std::string header(void) {
+        return "n\tmean\tsd\tmedian\tlower\tupper";
+    }
+
+    /**
+     * Write the summary as tab separated values
+     *
+     * @param interval Width of the (quantile) interval e.g. 0.95 for 2.5% and 97.5% quantiles
+     */
+    void write(std::ostream& stream, double interval = 0.95) {
+        stream
+            << moments.count() << "\t"
+            << moments.mean() << "\t"
+            << moments.sd() << "\t"
+            << sketch.quantile(0.5) << "\t"
+            << sketch.quantile((1 - interval)/2) << "\t"
+            << sketch.quantile((1 + interval)/2);
+    }
+
+};  // class Summary
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+
+#include "model.hpp"
+#include "pool.hpp"
+
+/**
+ * A parameter sweep for sensitivity analyses
+ *
+ * Generates a design (a Latin hypercube or a Sobol sequence) over the
+ * ranges of a set of parameters and runs replicates of `Model` at each
+ * design point concurrently on a `Pool`. Inputs are read once and copied
+ * into each model. Outputs are written to `output/sweep`:
+ *
+ *  - `design.tsv`: the parameter values at each design point
+ *  - `results.tsv`: spawning biomass, status and catch by year and region for
+ *    each replicate of each design point
+ *  - `failures.tsv`: replicates of design points that could not be run
+ */
+class Sweep : public Structure<Sweep> {
+ public:
+
+    /**
+     * The range of a parameter
+     */
+    struct Range {
+        std::string parameter;
+        double lower;
+        double upper;
+    };
+
+    /**
+     * Ranges of the parameters to vary
+     *
+     * Can be overidden in `input/sweep_ranges.tsv` (columns `parameter`, `lower`
+     * and `upper`). For `fishes_movement` the value is the probability of moving to
+     * each other region (i.e. all off-diagonal elements of the movement matrix) so
+     * it can be at most 0.5 (see `check()`).
+     */
+    std::vector<Range> ranges = {
+        {"fishes_m", 0.05, 0.1},
+        {"fishes_steepness", 0.7, 0.95},
+        {"fishes_k_mean", 0.08, 0.12},
+        {"fishes_linf_mean", 55, 65},
+        {"fishes_movement", 0, 0.1},
+        {"harvest_handling_mortality", 0, 0.2}
+    };
+
+    /**
+     * Number of design points
+     */
+    unsigned int points = 20;
+
+    /**
+     * Type of design
+     *
+     * l = Latin hypercube
+     * s = Sobol sequence
+     */
+    char design = 'l';
+
+    /**
+     * Number of replicates at each design point
+     *
+     * Replicate `r` of every design point is seeded with `seed + r` so that
+     * differences between points are not confounded with differences in seeds.
+     */
+    unsigned int replicates = 1;
+
+    /**
+     * Number of threads to use (0 = number of cores)
+     */
+    unsigned int threads = 0;
+
+    /**
+     * Random seed (for both the Latin hypercube and the replicates)
+     */
+    unsigned int seed = std::time(0);
+
+    /**
+     * Time period for each replicate
+     */
+    Time start = 1900;
+    Time finish = 2018;
+
+    /**
+     * Directory for sweep output files
+     */
+    std::string directory = "output/sweep";
+
+    /**
+     * Initialise the sweep
+     *
+     * Settings can be overidden in `input/sweep.json` and
+     * ranges in `input/sweep_ranges.tsv`
+     */
+    void initialise(void) {
+        if (boost::filesystem::exists("input/sweep.json")) read("input/sweep.json");
+        if (boost::filesystem::exists("input/sweep_ranges.tsv")) ranges_read("input/sweep_ranges.tsv");
+    }
+
+    template<class Mirror>
+    void reflect(Mirror& mirror){
+        mirror
+            .data(points, "points")
+            .data(design, "design")
+            .data(replicates, "replicates")
+            .data(threads, "threads")
+            .data(seed, "seed")
+        ;
+    }
+
+    /**
+     * Generate the design
+     *
+     * @return A matrix (point by parameter) of values in [0, 1)
+     */
+    std::vector<std::vector<double>> generate(void) const {
+        switch (design) {
+            case 'l': return latin_hypercube(points, ranges.size(), seed);
+            case 's': return sobol(points, ranges.size());
+        }
+        throw std::runtime_error(std::string("Unknown sweep design: ") + design);
+    }
+
+    /**
+     * Generate a Latin hypercube design
+     *
+     * Each dimension is divided into `points` equal strata and each stratum
+     * is sampled exactly once with the strata of different dimensions
+     * randomly paired.
+     */
+    static std::vector<std::vector<double>> latin_hypercube(unsigned int points, unsigned int dimensions, unsigned int seed) {
+        Random random(seed);
+        std::vector<std::vector<double>> values(points, std::vector<double>(dimensions));
+        std::vector<unsigned int> strata(points);
+        for (unsigned int dimension = 0; dimension < dimensions; dimension++) {
+            std::iota(strata.begin(), strata.end(), 0);
+            for (unsigned int index = points - 1; index > 0; index--) {
+                std::swap(strata[index], strata[unsigned(random.chance() * (index + 1))]);
+            }
+            for (unsigned int point = 0; point < points; point++) {
+                values[point][dimension] = (strata[point] + random.chance())/points;
+            }
+        }
+        return values;
+    }
+
+    /**
+     * Generate a Sobol sequence design
+     *
+     * Uses the direction numbers of Joe & Kuo (2008). The first point of the
+     * sequence (the origin) is skipped.
+     */
+    static std::vector<std::vector<double>> sobol(unsigned int points, unsigned int dimensions) {
+        // Degree, coefficients and initial direction numbers for
+        // each dimension after the first
+        struct Primitive {
+            unsigned int degree;
+            unsigned int coefficients;
+            std::vector<uint32_t> initial;
+        };
+        static const std::vector<Primitive> primitives = {
+            {1, 0, {1}},
+            {2, 1, {1, 3}},
+            {3, 1, {1, 3, 1}},
+            {3, 2, {1, 1, 1}},
+            {4, 1, {1, 1, 3, 3}},
+            {4, 4, {1, 3, 5, 13}},
+            {5, 2, {1, 1, 5, 5, 17}},
+            {5, 4, {1, 1, 5, 5, 5}}
+        };
+        if (dimensions > primitives.size() + 1) {
+            throw std::runtime_error("Too many dimensions for Sobol design: " + std::to_string(dimensions));
+        }
+
+        const unsigned int bits = 32;
+        std::vector<std::vector<double>> values(points, std::vector<double>(dimensions));
+        for (unsigned int dimension = 0; dimension < dimensions; dimension++) {
+            std::vector<uint32_t> directions(bits);
+            if (dimension == 0) {
+                for (unsigned int bit = 0; bit < bits; bit++) directions[bit] = uint32_t(1) << (bits - 1 - bit);
+            } else {
+                const auto& primitive = primitives[dimension - 1];
+                auto degree = primitive.degree;
+                for (unsigned int bit = 0; bit < bits; bit++) {
+                    if (bit < degree) {
+                        directions[bit] = primitive.initial[bit] << (bits - 1 - bit);
+                    } else {
+                        directions[bit] = directions[bit - degree] ^ (directions[bit - degree] >> degree);
+                        for (unsigned int k = 1; k < degree; k++) {
+                            if ((primitive.coefficients >> (degree - 1 - k)) & 1) directions[bit] ^= directions[bit - k];
+                        }
+                    }
+                }
+            }
+
+            uint32_t value = 0;
+            for (unsigned int index = 1; index <= points; index++) {
+                // Gray code construction: flip the direction number of the
+                // lowest zero bit of the previous index
+                unsigned int bit = 0;
+                for (auto previous = index - 1; previous & 1; previous >>= 1) bit++;
+                value ^= directions[bit];
+                values[index - 1][dimension] = value/4294967296.0;
+            }
+        }
+        return values;
+    }
+
+    /**
+     * Check that all values in the range of a parameter are valid
+     *
+     * For `fishes_movement`, values above `1/(regions - 1)` would make the
+     * probability of staying in a region negative.
+     */
+    static void check(const Range& range) {
+        if (range.lower > range.upper) {
+            throw std::runtime_error("Lower bound of sweep range is above upper bound for: " + range.parameter);
+        }
+        if (range.parameter == "fishes_movement") {
+            if (range.lower < 0 or range.upper > movement_max()) {
+                throw std::runtime_error("Sweep range for fishes_movement must be within 0 and " + std::to_string(movement_max()));
+            }
+        }
+    }
+
+    /**
+     * Set the value of a parameter
+     */
+    static void apply(Parameters& parameters, const std::string& parameter, double value) {
+        if (parameter == "fishes_m") parameters.fishes_m = value;
+        else if (parameter == "fishes_steepness") parameters.fishes_steepness = value;
+        else if (parameter == "fishes_k_mean") parameters.fishes_k_mean = value;
+        else if (parameter == "fishes_linf_mean") parameters.fishes_linf_mean = value;
+        else if (parameter == "fishes_movement") {
+            if (value < 0 or value > movement_max()) {
+                throw std::runtime_error("Invalid value for fishes_movement: " + std::to_string(value));
+            }
+            // Rows of the movement matrix sum to 1
+            for (auto region : regions) {
+                double stay = 1;
+                for (auto region_to : region_tos) {
+                    if (region.index() == region_to.index()) continue;
+                    parameters.fishes_movement(region, region_to) = value;
+                    stay -= value;
+                }
+                parameters.fishes_movement(region, region) = stay;
+            }
+        }
+        else if (parameter == "harvest_handling_mortality") parameters.harvest_handling_mortality = value;
+        else throw std::runtime_error("Unknown sweep parameter: " + parameter);
+    }
+
+    /**
+     * Run the sweep
+     *
+     * @param parameters Parameters shared by all design points (other than those varied)
+     */
+    void run(const Parameters& parameters) {
+        for (const auto& range : ranges) check(range);
+        auto values = generate();
+
+        // Parameters for each design point
+        std::vector<Parameters> designs(points, parameters);
+        for (unsigned int point = 0; point < points; point++) {
+            for (unsigned int dimension = 0; dimension < ranges.size(); dimension++) {
+                const auto& range = ranges[dimension];
+                auto& value = values[point][dimension];
+                value = range.lower + value * (range.upper - range.lower);
+                apply(designs[point], range.parameter, value);
+            }
+            designs[point].update();
+        }
+
+        boost::filesystem::create_directories(directory);
+
+        auto compression = parameters.output_compression;
+
+        Output design_file(directory + "/design.tsv", compression);
+        design_file << "point";
+        for (const auto& range : ranges) design_file << "\t" << range.parameter;
+        design_file << "\n";
+        for (unsigned int point = 0; point < points; point++) {
+            design_file << point;
+            for (auto value : values[point]) design_file << "\t" << value;
+            design_file << "\n";
+        }
+        design_file.close();
+
+        results_file_.open(directory + "/results.tsv", compression);
+        results_file_ << "point\treplicate\tyear\tregion\tbiomass\tstatus\tcatch\n";
+
+        failures_file_.open(directory + "/failures.tsv", compression);
+        failures_file_ << "point\treplicate\terror\n";
+
+        Pool pool(threads);
+        for (unsigned int point = 0; point < points; point++) {
+            for (unsigned int replicate = 0; replicate < replicates; replicate++) {
+                pool.submit([this, &designs, point, replicate](){
+                    auto began = std::chrono::steady_clock::now();
+
+                    // Some design points may be at parameter values for which the model
+                    // can not be run (e.g. the catch history can not be taken) so record
+                    // those as failures rather than abandoning the whole sweep
+                    std::unique_ptr<Model> model(new Model);
+                    try {
+                        model->context.seed(seed + replicate);
+                        model->initialise(designs[point]);
+                        model->run(start, finish);
+                    } catch (const std::exception& error) {
+                        fail(point, replicate, error.what());
+                        return;
+                    }
+
+                    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - began;
+                    record(point, replicate, *model, duration.count());
+                });
+            }
+        }
+        pool.wait();
+
+        results_file_.close();
+        failures_file_.close();
+    }
+
+ private:
+
+    std::mutex mutex_;
+    Output results_file_;
+    Output failures_file_;
+
+    /**
+     * Maximum probability of moving to each other region
+     */
+    static double movement_max(void) {
+        return 1.0/(Regions::size() - 1);
+    }
+
+    /**
+     * Read parameter ranges from a tab separated file with a header
+     */
+    void ranges_read(const std::string& path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        ranges.clear();
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            std::istringstream stream(line);
+            Range range;
+            stream >> range.parameter >> range.lower >> range.upper;
+            if (stream.fail()) throw std::runtime_error("Error reading sweep range: " + line);
+            check(range);
+            ranges.push_back(range);
+        }
+    }
+
+    /**
+     * Record a replicate of a design point that failed
+     */
+    void fail(unsigned int point, unsigned int replicate, const std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::cout << "point " << point << " replicate " << replicate << " failed: " << error << std::endl;
+        failures_file_ << point << "\t" << replicate << "\t" << error << "\n";
+    }
+
+    /**
+     * Record the outputs of a replicate of a design point
+     */
+    void record(unsigned int point, unsigned int replicate, const Model& model, double seconds) {
+        const auto& monitor = model.monitor;
+        const auto& parameters = model.context.parameters;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::cout << "point " << point << " replicate " << replicate << " finished in " << seconds << "s" << std::endl;
+
+        for (auto year : years) {
+            if (year < start or year > finish) continue;
+            for (auto region : regions) {
+                double catches = 0;
+                for (auto method : methods) catches += monitor.catches(year, region, method);
+                results_file_
+                    << point << "\t"
+                    << replicate << "\t"
+                    << year << "\t"
+                    << region_code(region) << "\t"
+                    << monitor.biomass_spawners(year, region) << "\t"
+                    << monitor.biomass_spawners(year, region)/parameters.fishes_b0(region) << "\t"
+                    << catches << "\n";
+            }
+        }
+    }
+
+};  // class Sweep
@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "monitor-tagging.hpp"
+
+/**
+ * An indexed, binary, archive of tag release and recapture pairs
+ *
+ * Analyses of tagging data (e.g. Petersen estimates and growth estimation) usually only
+ * need some of the pairs (e.g. those released in some years, or recaptured after some
+ * time at liberty) but parsing `releases.tsv` and `recaptures.tsv` for each replicate
+ * means reading all of them, as text. This writes the `Tagging::Tags` database as binary
+ * columns, with the rows ordered by release year and region, and with indices that
+ * allow `select()` to read only the rows for a query. Read into R using `read_tags()`
+ * in `scripts/sna1-read-tags.r`.
+ *
+ * Layout (all numbers are little-endian):
+ *
+ *   header
+ *     char[8]      "SNA1TAGS"
+ *     uint32       version (1)
+ *     uint32       number of rows i.e. tags (N)
+ *     uint32       first year (Years_min)
+ *     uint32       number of years (Y)
+ *     uint32       number of regions (R)
+ *     uint32       number of recaptured tags (M)
+ *   release index
+ *     uint32[Y*R+1]  first row released in each year and region (rows for year `y` and
+ *                    region `r` are from `[y*R+r]` up to `[y*R+r+1]`)
+ *   liberty index
+ *     uint32[Y+1]  first entry in the liberty rows for each number of years at liberty
+ *     uint32[M]    rows of recaptured tags ordered by years at liberty, then by row
+ *   columns
+ *     uint32[N]    tag
+ *     uint16[N]    release time
+ *     uint8[N]     release region
+ *     uint8[N]     release method
+ *     float32[N]   release length
+ *     uint16[N]    recapture time (zero if not recaptured)
+ *     uint8[N]     recapture region
+ *     uint8[N]     recapture method
+ *     float32[N]   recapture length
+ *
+ * Archives are not compressed (that would prevent reading only some rows).
+ */
+class TagArchive {
+ public:
+
+    /**
+     * A tag release and (if `recaptured()`) recapture
+     */
+    struct Pair {
+        unsigned int tag;
+        Tagging::Event release;
+        Tagging::Event recapture;
+
+        bool recaptured(void) const {
+            return recapture.time != 0;
+        }
+
+        /**
+         * Number of years between release and recapture
+         */
+        unsigned int liberty(void) const {
+            return year(recapture.time) - year(release.time);
+        }
+    };
+
+    /**
+     * A selection of pairs
+     *
+     * By default, all pairs are selected.
+     */
+    struct Query {
+        /**
+         * Range of release years
+         */
+        unsigned int release_year_min = Years_min;
+        unsigned int release_year_max = Years_max;
+
+        /**
+         * Release region (-1 for any region)
+         */
+        int release_region = -1;
+
+        /**
+         * Only select pairs that have been recaptured?
+         */
+        bool recaptured = false;
+
+        /**
+         * Range of years at liberty (only recaptured pairs
+         * are selected if either of these are set)
+         */
+        unsigned int liberty_min = 0;
+        unsigned int liberty_max = Years::size() - 1;
+    };
+
+    /**
+     * Write an archive of tags
+     */
+    static void write(const Tagging::Tags& tags, const std::string& path) {
+        const unsigned int size = tags.size();
+        const unsigned int cells = Years::size() * Regions::size();
+
+        // Order rows by release year and region (and then by tag)
+        std::vector<uint32_t> release_index(cells + 1, 0);
+        for (unsigned int tag = 1; tag <= size; tag++) {
+            release_index[cell(tags.release(tag)) + 1]++;
+        }
+        for (unsigned int index = 0; index < cells; index++) {
+            release_index[index + 1] += release_index[index];
+        }
+        std::vector<uint32_t> order(size);
+        {
+            auto next = release_index;
+            for (unsigned int tag = 1; tag <= size; tag++) {
+                order[next[cell(tags.release(tag))]++] = tag;
+            }
+        }
+
+        // Order recaptured rows by years at liberty (and then by row)
+        std::vector<uint32_t> liberty_index(Years::size() + 1, 0);
+        for (unsigned int row = 0; row < size; row++) {
+            auto release = tags.release(order[row]);
+            auto recapture = tags.recapture(order[row]);
+            if (recapture.time) liberty_index[year(recapture.time) - year(release.time) + 1]++;
+        }
+        for (unsigned int index = 0; index < Years::size(); index++) {
+            liberty_index[index + 1] += liberty_index[index];
+        }
+        std::vector<uint32_t> liberty_rows(liberty_index.back());
+        {
+            auto next = liberty_index;
+            for (unsigned int row = 0; row < size; row++) {
+                auto release = tags.release(order[row]);
+                auto recapture = tags.recapture(order[row]);
+                if (recapture.time) liberty_rows[next[year(recapture.time) - year(release.time)]++] = row;
+            }
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        if (not file) throw std::runtime_error("Unable to open file: " + path);
+        file.write("SNA1TAGS", 8);
+        put<uint32_t>(file, 1);
+        put<uint32_t>(file, size);
+        put<uint32_t>(file, Years_min);
+        put<uint32_t>(file, Years::size());
+        put<uint32_t>(file, Regions::size());
+        put<uint32_t>(file, liberty_rows.size());
+        put(file, release_index);
+        put(file, liberty_index);
+        put(file, liberty_rows);
+
+        put(file, order);
+        for (auto recaptures : {false, true}) {
+            std::vector<uint16_t> time(size);
+            std::vector<uint8_t> region(size);
+            std::vector<uint8_t> method(size);
+            std::vector<float> length(size);
+            for (unsigned int row = 0; row < size; row++) {
+                auto event = recaptures ? tags.recapture(order[row]) : tags.release(order[row]);
+                time[row] = event.time;
+                region[row] = event.region;
+                method[row] = event.method;
+                length[row] = event.length;
+            }
+            put(file, time);
+            put(file, region);
+            put(file, method);
+            put(file, length);
+        }
+        if (not file) throw std::runtime_error("Error writing tag archive: " + path);
+    }
+
+    /**
+     * Open an archive
+     *
+     * Only the header and the release index are read.
+     */
+    TagArchive(const std::string& path):
+        path_(path),
+        file_(path, std::ios::binary) {
+        char magic[8];
+        file_.read(magic, 8);
+        if (not file_ or std::string(magic, 8) != "SNA1TAGS") throw std::runtime_error("Not a tag archive: " + path);
+        get<uint32_t>();
+        size_ = get<uint32_t>();
+        auto year_min = get<uint32_t>();
+        auto years = get<uint32_t>();
+        auto regions = get<uint32_t>();
+        recaptured_ = get<uint32_t>();
+        if (year_min != Years_min or years != Years::size() or regions != Regions::size()) {
+            throw std::runtime_error("Tag archive has different dimensions to this model: " + path);
+        }
+        release_index_.resize(years * regions + 1);
+        get(release_index_.data(), header, release_index_.size());
+
+        // Offsets of the sections after the release index
+        liberty_index_offset_ = header + release_index_.size() * sizeof(uint32_t);
+        liberty_rows_offset_ = liberty_index_offset_ + (years + 1) * sizeof(uint32_t);
+        columns_offset_ = liberty_rows_offset_ + recaptured_ * sizeof(uint32_t);
+    }
+
+    /**
+     * Number of tags
+     */
+    unsigned int size(void) const {
+        return size_;
+    }
+
+    /**
+     * Number of tags that have been recaptured
+     */
+    unsigned int recaptured(void) const {
+        return recaptured_;
+    }
+
+    /**
+     * Select pairs
+     *
+     * Uses whichever of the release and liberty indices gives fewer candidate rows
+     * and reads only those rows. Pairs are returned in order of release year and
+     * region and then of tag.
+     */
+    std::vector<Pair> select(const Query& query) {
+        auto year_min = std::max(query.release_year_min, Years_min);
+        auto year_max = std::min(query.release_year_max, Years_max);
+        auto liberty_min = query.liberty_min;
+        auto liberty_max = std::min<unsigned int>(query.liberty_max, Years::size() - 1);
+        if (year_min > year_max or liberty_min > liberty_max) return {};
+        bool liberty = liberty_min > 0 or liberty_max < Years::size() - 1;
+
+        // Candidate rows from the release index, as ranges
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        uint32_t release_candidates = 0;
+        for (auto y = year_min; y <= year_max; y++) {
+            for (unsigned int region = 0; region < Regions::size(); region++) {
+                if (query.release_region >= 0 and int(region) != query.release_region) continue;
+                auto begin = release_index_[(y - Years_min) * Regions::size() + region];
+                auto end = release_index_[(y - Years_min) * Regions::size() + region + 1];
+                if (begin == end) continue;
+                if (ranges.size() and ranges.back().second == begin) ranges.back().second = end;
+                else ranges.emplace_back(begin, end);
+                release_candidates += end - begin;
+            }
+        }
+
+        // Candidate rows from the liberty index, if it gives fewer
+        if (liberty or query.recaptured) {
+            uint32_t bounds[2];
+            file_.seekg(liberty_index_offset_ + liberty_min * sizeof(uint32_t));
+            file_.read(reinterpret_cast<char*>(&bounds[0]), sizeof(uint32_t));
+            file_.seekg(liberty_index_offset_ + (liberty_max + 1) * sizeof(uint32_t));
+            file_.read(reinterpret_cast<char*>(&bounds[1]), sizeof(uint32_t));
+            if (not file_) throw std::runtime_error("Truncated tag archive: " + path_);
+            if (bounds[1] - bounds[0] < release_candidates) {
+                std::vector<uint32_t> rows(bounds[1] - bounds[0]);
+                get(rows.data(), liberty_rows_offset_ + bounds[0] * sizeof(uint32_t), rows.size());
+                std::sort(rows.begin(), rows.end());
+                ranges.clear();
+                for (auto row : rows) {
+                    if (ranges.size() and ranges.back().second == row) ranges.back().second++;
+                    else ranges.emplace_back(row, row + 1);
+                }
+            }
+        }
+
+        std::vector<Pair> pairs;
+        for (const auto& range : ranges) {
+            for (const auto& pair : read(range.first, range.second)) {
+                auto y = year(pair.release.time);
+                if (y < year_min or y > year_max) continue;
+                if (query.release_region >= 0 and int(pair.release.region) != query.release_region) continue;
+                if ((liberty or query.recaptured) and not pair.recaptured()) continue;
+                if (liberty and (pair.liberty() < liberty_min or pair.liberty() > liberty_max)) continue;
+                pairs.push_back(pair);
+            }
+        }
+        return pairs;
+    }
+
+    /**
+     * Select all pairs
+     */
+    std::vector<Pair> select(void) {
+        return read(0, size_);
+    }
+
+ private:
+
+    /**
+     * Size of the header in bytes
+     */
+    static const std::streamoff header = 8 + 6 * sizeof(uint32_t);
+
+    std::string path_;
+    std::ifstream file_;
+    uint32_t size_;
+    uint32_t recaptured_;
+    std::vector<uint32_t> release_index_;
+    std::streamoff liberty_index_offset_;
+    std::streamoff liberty_rows_offset_;
+    std::streamoff columns_offset_;
+
+    static unsigned int cell(const Tagging::Event& release) {
+        auto y = year(release.time);
+        if (y < Years_min or y > Years_max) throw std::runtime_error("Tag release outside of model years: " + std::to_string(y));
+        return (y - Years_min) * Regions::size() + release.region;
+    }
+
+    /**
+     * Read a range of rows
+     */
+    std::vector<Pair> read(uint32_t begin, uint32_t end) {
+        auto rows = end - begin;
+        std::vector<uint32_t> tag(rows);
+        std::vector<uint16_t> time(rows);
+        std::vector<uint8_t> region(rows);
+        std::vector<uint8_t> method(rows);
+        std::vector<float> length(rows);
+
+        std::vector<Pair> pairs(rows);
+        std::streamoff offset = columns_offset_;
+        get(tag.data(), offset + begin * sizeof(uint32_t), rows);
+        offset += size_ * sizeof(uint32_t);
+        for (auto event : {&Pair::release, &Pair::recapture}) {
+            get(time.data(), offset + begin * sizeof(uint16_t), rows);
+            offset += size_ * sizeof(uint16_t);
+            get(region.data(), offset + begin * sizeof(uint8_t), rows);
+            offset += size_ * sizeof(uint8_t);
+            get(method.data(), offset + begin * sizeof(uint8_t), rows);
+            offset += size_ * sizeof(uint8_t);
+            get(length.data(), offset + begin * sizeof(float), rows);
+            offset += size_ * sizeof(float);
+            for (unsigned int row = 0; row < rows; row++) {
+                pairs[row].*event = {time[row], Region(region[row]), Method(method[row]), length[row]};
+            }
+        }
+        for (unsigned int row = 0; row < rows; row++) pairs[row].tag = tag[row];
+        return pairs;
+    }
+
+    template<class Type>
+    Type get(void) {
+        Type value;
+        file_.read(reinterpret_cast<char*>(&value), sizeof(Type));
+        return value;
+    }
+
+    template<class Type>
+    void get(Type* values, std::streamoff offset, std::size_t count) {
+        file_.seekg(offset);
+        file_.read(reinterpret_cast<char*>(values), count * sizeof(Type));
+        if (not file_) throw std::runtime_error("Truncated tag archive: " + path_);
+    }
+
+    template<class Type>
+    static void put(std::ostream& stream, Type value) {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(Type));
+    }
+
+    template<class Type>
+    static void put(std::ostream& stream, const std::vector<Type>& values) {
+        stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Type));
+    }
+
+};  // class TagArchive
@@ -0,0 +1,103 @@
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "../blocks.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(blocks)
+
+BOOST_AUTO_TEST_CASE(growth){
+	// Small blocks (of 4 items) so that there are several
+	Blocks<int, 2> items;
+	items.push_back(0);
+	int* first = &items[0];
+	for (int item = 1; item < 10; item++) items.push_back(item);
+
+	BOOST_CHECK_EQUAL(items.size(), 10);
+	BOOST_CHECK_EQUAL(items.blocks(), 3);
+	BOOST_CHECK_EQUAL(items.capacity(), 12);
+	// Growth does not move existing items
+	BOOST_CHECK_EQUAL(first, &items[0]);
+
+	// Iteration is in order across blocks
+	int expected = 0;
+	for (auto item : items) BOOST_CHECK_EQUAL(item, expected++);
+	BOOST_CHECK_EQUAL(expected, 10);
+
+	// Blocks cover all items
+	unsigned int count = 0;
+	for (unsigned int block = 0; block < items.blocks(); block++) count += items.block(block).size();
+	BOOST_CHECK_EQUAL(count, 10);
+	BOOST_CHECK_EQUAL(items.block(2).size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(erase){
+	Blocks<int, 2> items(10);
+	for (unsigned int index = 0; index < items.size(); index++) items[index] = index;
+
+	auto removed = items.erase_if([](int item){ return item % 3 == 0; });
+	BOOST_CHECK_EQUAL(removed, 4);
+	BOOST_CHECK_EQUAL(items.size(), 6);
+	BOOST_CHECK_EQUAL(items[0], 1);
+	BOOST_CHECK_EQUAL(items[5], 8);
+
+	// Unused blocks are kept until released
+	BOOST_CHECK_EQUAL(items.capacity(), 12);
+	items.shrink_to_fit();
+	BOOST_CHECK_EQUAL(items.capacity(), 8);
+
+	items.clear();
+	BOOST_CHECK(items.begin() == items.end());
+	BOOST_CHECK_EQUAL(items.capacity(), 8);
+}
+
+BOOST_AUTO_TEST_CASE(copy){
+	Blocks<int, 2> items(6);
+	items[5] = 42;
+	Blocks<int, 2> other;
+	other = items;
+	BOOST_CHECK_EQUAL(other.size(), 6);
+	BOOST_CHECK_EQUAL(other[5], 42);
+	BOOST_CHECK_EQUAL(other[0], 0);
+}
+
+BOOST_AUTO_TEST_CASE(allocation){
+	// Huge pages and interleaving are only requests so just check that
+	// items can be stored, copied and released with each allocation
+	for (auto pages : {'n', 't', 'e'}) {
+		for (auto placement : {'f', 'i'}) {
+			Blocks<int, 20> items;
+			items.allocation.pages = pages;
+			items.allocation.placement = placement;
+			items.resize(3000000);
+			items[2999999] = 42;
+			BOOST_CHECK_EQUAL(items[2999999], 42);
+			Blocks<int, 20> copy = items;
+			BOOST_CHECK_EQUAL(copy[2999999], 42);
+			items.clear();
+			items.shrink_to_fit();
+			BOOST_CHECK_EQUAL(items.capacity(), 0);
+		}
+	}
+
+	// File backed
+	{
+		Blocks<int, 20> items;
+		items.allocation.directory = boost::filesystem::temp_directory_path().string();
+		items.resize(3000000);
+		items.advise('s');
+		for (unsigned int index = 0; index < items.size(); index++) items[index] = index;
+		items.advise('n');
+		BOOST_CHECK_EQUAL(items[2999999], 2999999);
+		items.resize(1000);
+		items.shrink_to_fit();
+		BOOST_CHECK_EQUAL(items[999], 999);
+	}
+
+	Blocks<int> items;
+	items.allocation.pages = 'x';
+	BOOST_CHECK_THROW(items.push_back(1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,38 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "../columnar.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(columnar)
+
+BOOST_AUTO_TEST_CASE(round_trip){
+	auto path = (boost::filesystem::temp_directory_path() / "columnar-test.col").string();
+	{
+		Columnar file(path, {{"time", {}}, columnar_regions(), columnar_methods()});
+		file.append({1900, 0, 1}, 1.5);
+		file.append({1900, 1, 1}, 0);
+		file.flush();
+		file.append({1901, 2, 3}, -2);
+	}
+
+	auto contents = Columnar::read(path);
+	BOOST_CHECK_EQUAL(contents.dimensions.size(), 3);
+	BOOST_CHECK_EQUAL(contents.dimensions[0].labels.size(), 0);
+	BOOST_CHECK_EQUAL(contents.dimensions[1].labels[2], "BP");
+	BOOST_CHECK_EQUAL(contents.dimensions[2].labels[3], "RE");
+	BOOST_CHECK_EQUAL(contents.value, "value");
+
+	// Zeros are not written
+	BOOST_REQUIRE_EQUAL(contents.values.size(), 2);
+	BOOST_CHECK_EQUAL(contents.levels[0][0], 1900);
+	BOOST_CHECK_EQUAL(contents.levels[2][0], 1);
+	BOOST_CHECK_EQUAL(contents.values[0], 1.5);
+	BOOST_CHECK_EQUAL(contents.levels[0][1], 1901);
+	BOOST_CHECK_EQUAL(contents.levels[1][1], 2);
+	BOOST_CHECK_EQUAL(contents.values[1], -2);
+
+	boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
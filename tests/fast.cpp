@@ -5,5 +5,15 @@
  * Fast unit tests that are run frequently (ie. during development)
  */
 
+#include "blocks.cpp"
+#include "columnar.cpp"
 #include "fish.cpp"
 #include "harvest.cpp"
+#include "output.cpp"
+#include "pool.cpp"
+#include "sparse.cpp"
+#include "summary.cpp"
+#include "sweep.cpp"
+#include "tags.cpp"
+#include "tsv.cpp"
+#include "writer.cpp"
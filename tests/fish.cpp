@@ -6,44 +6,100 @@
 BOOST_AUTO_TEST_SUITE(fish)
 
 BOOST_AUTO_TEST_CASE(birth){
+	Context context;
 	Fish fish;
-	fish.born(HG);
+	fish.born(context, HG);
 
 	BOOST_CHECK(fish.alive());
 
 	BOOST_CHECK_EQUAL(fish.region, HG);
 
-	BOOST_CHECK_EQUAL(fish.age(), 0);
-	BOOST_CHECK_EQUAL(fish.age_bin(), 0);
+	BOOST_CHECK_EQUAL(fish.age(context), 0);
+	BOOST_CHECK_EQUAL(fish.age_bin(context), 0);
 
 	BOOST_CHECK_EQUAL(fish.length, 0);
 	BOOST_CHECK_EQUAL(fish.length_bin(), 0);
 }
 
 BOOST_AUTO_TEST_CASE(seed){
+	Context context;
 	Fish fish;
-	fish.seed();
+	fish.seed(context);
 
 	BOOST_CHECK(fish.alive());
 
-	BOOST_CHECK(fish.age() > 0);
+	BOOST_CHECK(fish.age(context) > 0);
 	BOOST_CHECK(fish.length > 0);
 }
 
+BOOST_AUTO_TEST_CASE(contexts){
+	// Fish born in contexts with the same seed are identical
+	// regardless of what happens in other contexts
+	Context context1;
+	Context context2;
+	Context context3;
+	context1.seed(42);
+	context2.seed(42);
+
+	Fish fish1;
+	fish1.born(context1, EN);
+	Fish fish3;
+	fish3.born(context3, EN);
+	Fish fish2;
+	fish2.born(context2, EN);
+
+	BOOST_CHECK_EQUAL(fish1.sex, fish2.sex);
+	BOOST_CHECK_EQUAL(fish1.growth_intercept, fish2.growth_intercept);
+	BOOST_CHECK_EQUAL(fish1.growth_slope, fish2.growth_slope);
+}
+
+BOOST_AUTO_TEST_CASE(common_random_numbers){
+	// With common random numbers, the same fish draws the same
+	// numbers regardless of other draws made from the context
+	Context context1;
+	Context context2;
+	context1.seed(42);
+	context2.seed(42);
+	context1.parameters.random_common = true;
+	context2.parameters.random_common = true;
+
+	for (int draw = 0; draw < 10; draw++) context2.chance();
+
+	Fish fish1;
+	fish1.born(context1, BP, 3);
+	Fish fish2;
+	fish2.born(context2, BP, 3);
+
+	BOOST_CHECK_EQUAL(fish1.id, fish2.id);
+	BOOST_CHECK_EQUAL(fish1.id, Stream::key(context1.now, BP + 1, 3));
+	BOOST_CHECK_EQUAL(fish1.growth_intercept, fish2.growth_intercept);
+
+	context1.now = context2.now = 10;
+	fish1.growth(context1);
+	fish2.growth(context2);
+	BOOST_CHECK_EQUAL(fish1.length, fish2.length);
+
+	// But different fish draw different numbers
+	Fish fish3;
+	fish3.born(context1, BP, 4);
+	BOOST_CHECK(fish3.id != fish1.id);
+	BOOST_CHECK(fish3.growth_intercept != fish1.growth_intercept);
+}
+
 // Runs fish movement over many time steps and many 
 // fish and calculates the resulting distribution of fish 
 // across regions for each home region
-Array<double, Regions, RegionTos> movement_run(void) {
+Array<double, Regions, RegionTos> movement_run(Context& context) {
 	Fishes fishes(5000);
 
 	int count = 0;
 	for (auto& fish : fishes) {
-		fish.born(Region(count++ % 3));
+		fish.born(context, Region(count++ % 3));
 	}
 
 	for (int t=0; t<100; t++) {
 		for (auto& fish : fishes) {
-			fish.movement();
+			fish.movement(context);
 		}
 	}
 
@@ -57,10 +113,12 @@ Array<double, Regions, RegionTos> movement_run(void) {
 }
 
 BOOST_AUTO_TEST_CASE(movement_none){
+	Context context;
+	auto& parameters = context.parameters;
 	parameters.fishes_movement_type = 'n';
 	parameters.fishes_movement = {};
 
-	auto dist = movement_run();
+	auto dist = movement_run(context);
 
 	BOOST_CHECK_CLOSE(dist(EN, EN), 1.0, 1);
 	BOOST_CHECK(dist(EN, HG) < 0.00001);
@@ -73,11 +131,11 @@ BOOST_AUTO_TEST_CASE(movement_none){
 	BOOST_CHECK(dist(BP, EN) < 0.00001);
 	BOOST_CHECK(dist(BP, HG) < 0.00001);
 	BOOST_CHECK_CLOSE(dist(BP, BP), 1.0, 1);
-	
-	parameters.initialise();
 }
 
 BOOST_AUTO_TEST_CASE(movement_markov){
+	Context context;
+	auto& parameters = context.parameters;
 	parameters.fishes_movement_type = 'm';
 	parameters.fishes_movement = {
 		0.8, 0.1, 0.1,
@@ -85,7 +143,7 @@ BOOST_AUTO_TEST_CASE(movement_markov){
 		0.1, 0.1, 0.8
 	};
 
-	auto dist = movement_run();
+	auto dist = movement_run(context);
 
 	BOOST_CHECK_SMALL(dist(EN, EN) - 0.333, 0.05);
 	BOOST_CHECK_SMALL(dist(EN, HG) - 0.333, 0.05);
@@ -98,11 +156,11 @@ BOOST_AUTO_TEST_CASE(movement_markov){
 	BOOST_CHECK_SMALL(dist(BP, EN) - 0.333, 0.05);
 	BOOST_CHECK_SMALL(dist(BP, HG) - 0.333, 0.05);
 	BOOST_CHECK_SMALL(dist(BP, BP) - 0.333, 0.05);
-
-	parameters.initialise();
 }
 
 BOOST_AUTO_TEST_CASE(movement_home){
+	Context context;
+	auto& parameters = context.parameters;
 	parameters.fishes_movement_type = 'h';
 	parameters.fishes_movement = {
 		0.8, 0.1, 0.1,
@@ -110,7 +168,7 @@ BOOST_AUTO_TEST_CASE(movement_home){
 		0.1, 0.3, 0.6
 	};
 
-	auto dist = movement_run();
+	auto dist = movement_run(context);
 
 	BOOST_CHECK_SMALL(dist(EN, EN) - 0.8, 0.05);
 	BOOST_CHECK_SMALL(dist(EN, HG) - 0.1, 0.05);
@@ -123,8 +181,125 @@ BOOST_AUTO_TEST_CASE(movement_home){
 	BOOST_CHECK_SMALL(dist(BP, EN) - 0.1, 0.05);
 	BOOST_CHECK_SMALL(dist(BP, HG) - 0.3, 0.05);
 	BOOST_CHECK_SMALL(dist(BP, BP) - 0.6, 0.05);
+}
 
-	parameters.initialise();
+BOOST_AUTO_TEST_CASE(super_individuals){
+	Context context;
+	auto& parameters = context.parameters;
+	parameters.fishes_recruit_count = 100;
+	parameters.fishes_split_age = 5;
+	parameters.update();
+
+	Fishes fishes;
+	fishes.resize(1);
+	fishes[0].born(context, HG);
+	BOOST_CHECK_EQUAL(fishes[0].count, 100);
+
+	// Natural mortality decrements the count
+	context.now++;
+	fishes[0].survival(context);
+	BOOST_CHECK(fishes[0].count < 100);
+	BOOST_CHECK(fishes[0].count > 80);
+	auto count = fishes[0].count;
+
+	// Harvest decrements the count
+	fishes[0].decrement(context);
+	BOOST_CHECK_EQUAL(fishes[0].count, count - 1);
+	BOOST_CHECK(fishes[0].alive());
+
+	// A single individual can be split off (e.g. for tagging)
+	auto& single = fishes.single(0);
+	BOOST_CHECK_EQUAL(single.count, 1);
+	BOOST_CHECK_EQUAL(fishes.size(), 2);
+	BOOST_CHECK_EQUAL(fishes[1].count, count - 2);
+	BOOST_CHECK(fishes[1].id != fishes[0].id);
+	BOOST_CHECK_EQUAL(fishes.number(false), count - 1);
+
+	// Super-individuals are split when they reach `fishes_split_age`
+	context.now += 3;
+	fishes.split(context);
+	BOOST_CHECK_EQUAL(fishes.size(), 2);
+	context.now += 2;
+	fishes.split(context);
+	BOOST_CHECK_EQUAL(fishes.size(), count - 1);
+	BOOST_CHECK_EQUAL(fishes.number(false), count - 1);
+}
+
+BOOST_AUTO_TEST_CASE(rescale){
+	Context context;
+	context.now = 2000;
+	auto& parameters = context.parameters;
+	parameters.fishes_seed_number = 1000;
+	parameters.fishes_instances_max = 2000;
+	parameters.fishes_instances_min = 500;
+	parameters.update();
+
+	Fishes fishes;
+	fishes.seed(context, 4000);
+	for (unsigned int index = 0; index < 10; index++) fishes[index].tag = index + 1;
+	auto number = fishes.number();
+
+	// Thinning
+	fishes.rescale(context);
+	BOOST_CHECK_EQUAL(fishes.rescales.size(), 1);
+	BOOST_CHECK_EQUAL(fishes.size(), fishes.rescales[0].instances_after);
+	BOOST_CHECK(fishes.size() > 900 and fishes.size() < 1100);
+	BOOST_CHECK_CLOSE(fishes.number(), number, 1e-6);
+	unsigned int tagged = 0;
+	for (const auto& fish : fishes) if (fish.tag) tagged++;
+	BOOST_CHECK_EQUAL(tagged, 10);
+
+	// Within limits
+	fishes.rescale(context);
+	BOOST_CHECK_EQUAL(fishes.rescales.size(), 1);
+
+	// Upsampling
+	for (unsigned int index = 300; index < fishes.size(); index++) fishes[index].dies(context);
+	number = fishes.number();
+	fishes.rescale(context);
+	BOOST_CHECK_EQUAL(fishes.rescales.size(), 2);
+	BOOST_CHECK(fishes.number(false) > 900 and fishes.number(false) < 1100);
+	BOOST_CHECK_CLOSE(fishes.number(), number, 1e-6);
+
+	// Limits on the wrong side of the seed number are rejected...
+	parameters.fishes_instances_min = 1500;
+	BOOST_CHECK_THROW(parameters.update(), std::runtime_error);
+	parameters.fishes_instances_min = 0;
+	parameters.fishes_instances_max = 800;
+	BOOST_CHECK_THROW(parameters.update(), std::runtime_error);
+
+	// ...and, if set directly, do nothing
+	parameters.fishes_instances_max = 0;
+	parameters.fishes_instances_min = 1500;
+	parameters.fishes_seed_number = 500;
+	auto size = fishes.size();
+	fishes.rescale(context);
+	BOOST_CHECK_EQUAL(fishes.rescales.size(), 2);
+	BOOST_CHECK_EQUAL(fishes.size(), size);
+}
+
+BOOST_AUTO_TEST_CASE(choose){
+	Context context;
+	context.seed(1);
+	context.parameters.harvest_sampling_batch = 100;
+
+	// Three full blocks and a partial one
+	Fishes fishes(Fishes::block_size * 3.5);
+	std::vector<unsigned int> chosen(fishes.blocks(), 0);
+	unsigned int switches = 0;
+	unsigned int last = 0;
+	for (unsigned int trial = 0; trial < 1000000; trial++) {
+		auto index = fishes.choose(context);
+		BOOST_REQUIRE(index < fishes.size());
+		auto block = index / Fishes::block_size;
+		chosen[block]++;
+		if (block != last) switches++;
+		last = block;
+	}
+	// Fish are chosen in batches from blocks in proportion to their size
+	BOOST_CHECK(switches < 10000);
+	BOOST_CHECK_CLOSE(chosen[0]/1000000.0, 1/3.5, 10);
+	BOOST_CHECK_CLOSE(chosen[3]/1000000.0, 0.5/3.5, 10);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
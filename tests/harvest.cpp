@@ -2,19 +2,22 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include "../fishes.hpp"
 #include "../harvest.hpp"
 
 
 BOOST_AUTO_TEST_SUITE(harvest)
 
 BOOST_AUTO_TEST_CASE(selectivity){
+	Context context;
+	auto& parameters = context.parameters;
 	Harvest harvest;
 
 	parameters.harvest_sel_mode = {20, 25, 30, 35};
 	parameters.harvest_sel_steep1 = {1, 3, 5, 10};
 	parameters.harvest_sel_steep2 = {1000, 100, 10, 5};
 
-	harvest.initialise();
+	harvest.initialise(context);
 
 	// Output selectivity at length
 	harvest.selectivity_at_length.write("tests/harvest/selectivity_at_length.tsv");
@@ -20,7 +20,7 @@ BOOST_AUTO_TEST_CASE(tagging_simple){
 	model.initialise();
 
 	// No movement
-	parameters.fishes_movement_type = 'n';
+	model.context.parameters.fishes_movement_type = 'n';
 
 	// Set up tagging program
 	auto& monitor = model.monitor;
@@ -49,18 +49,18 @@ BOOST_AUTO_TEST_CASE(tagging_simple){
 	// Record population size in each year
 	Array<int, Years, Regions> pop = 0;
 	std::function<void()> callback([&](){
-		if (year(now) >= 2000) {
+		if (year(model.context.now) >= 2000) {
 			for (const auto& fish : model.fishes) {
 				if (fish.alive() and (fish.length > tagging.release_length_min)) {
-					pop(year(now), fish.region)++;
+					pop(year(model.context.now), fish.region)++;
 				}
 			}
 			std::cout 
-				<< year(now) << "\t" 
+				<< year(model.context.now) << "\t" 
 				<< model.fishes.number(false) << "\t" 
-				<< pop(year(now), EN) << "\t" 
-				<< pop(year(now), HG) << "\t" 
-				<< pop(year(now), BP) << std::endl;
+				<< pop(year(model.context.now), EN) << "\t" 
+				<< pop(year(model.context.now), HG) << "\t" 
+				<< pop(year(model.context.now), BP) << std::endl;
 		}
 	});
 
@@ -99,15 +99,15 @@ BOOST_AUTO_TEST_CASE(tagging_estimate){
 
 	// Exponential growth model with no temporal variation
 	// and limited amount of individual variation
-	parameters.fishes_growth_model = 'e';
-	parameters.fishes_growth_variation = 'i';
-    parameters.fishes_k_mean = 0.1;
-    parameters.fishes_k_sd = 0.02;
-    parameters.fishes_linf_mean = 60;
-    parameters.fishes_linf_sd = 10;
+	model.context.parameters.fishes_growth_model = 'e';
+	model.context.parameters.fishes_growth_variation = 'i';
+    model.context.parameters.fishes_k_mean = 0.1;
+    model.context.parameters.fishes_k_sd = 0.02;
+    model.context.parameters.fishes_linf_mean = 60;
+    model.context.parameters.fishes_linf_sd = 10;
 
 	// No movement
-	parameters.fishes_movement_type = 'n';
+	model.context.parameters.fishes_movement_type = 'n';
 
 	// Set up tagging program
 	auto& monitor = model.monitor;
@@ -136,18 +136,18 @@ BOOST_AUTO_TEST_CASE(tagging_estimate){
 	// Record population size in each year
 	Array<int, Years, Regions> pop = 0;
 	std::function<void()> callback([&](){
-		if (year(now) >= 2000) {
+		if (year(model.context.now) >= 2000) {
 			for (const auto& fish : model.fishes) {
 				if (fish.alive() and (fish.length > tagging.release_length_min)) {
-					pop(year(now), fish.region)++;
+					pop(year(model.context.now), fish.region)++;
 				}
 			}
 			std::cout 
-				<< year(now) << "\t" 
+				<< year(model.context.now) << "\t" 
 				<< model.fishes.number(false) << "\t" 
-				<< pop(year(now), EN) << "\t" 
-				<< pop(year(now), HG) << "\t" 
-				<< pop(year(now), BP) << std::endl;
+				<< pop(year(model.context.now), EN) << "\t" 
+				<< pop(year(model.context.now), HG) << "\t" 
+				<< pop(year(model.context.now), BP) << std::endl;
 		}
 	});
 
@@ -0,0 +1,52 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "../output.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(output)
+
+BOOST_AUTO_TEST_CASE(gzip){
+	auto path = (boost::filesystem::temp_directory_path() / "output-test.tsv").string();
+	BOOST_CHECK_EQUAL(Output::path(path, 'g'), path + ".gz");
+
+	// Enough lines to overflow the buffer several times
+	std::string expected;
+	{
+		Output file(path, 'g');
+		for (int line = 0; line < 100000; line++) {
+			file << line << "\t" << line * 0.5 << "\n";
+			if (line == 50000) file.flush();
+		}
+	}
+	for (int line = 0; line < 100000; line++) {
+		std::ostringstream stream;
+		stream << line << "\t" << line * 0.5 << "\n";
+		expected += stream.str();
+	}
+
+	auto file = gzopen((path + ".gz").c_str(), "rb");
+	BOOST_REQUIRE(file);
+	std::string actual;
+	char buffer[4096];
+	int bytes;
+	while ((bytes = gzread(file, buffer, sizeof(buffer))) > 0) actual.append(buffer, bytes);
+	gzclose(file);
+
+	BOOST_CHECK(actual == expected);
+	BOOST_CHECK(boost::filesystem::file_size(path + ".gz") < expected.size() / 2);
+}
+
+BOOST_AUTO_TEST_CASE(none){
+	auto path = (boost::filesystem::temp_directory_path() / "output-test-none.tsv").string();
+	{
+		Output file(path);
+		file << "a\tb\n1\t2\n";
+	}
+	std::ifstream file(path);
+	std::stringstream content;
+	content << file.rdbuf();
+	BOOST_CHECK_EQUAL(content.str(), "a\tb\n1\t2\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,34 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../pool.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(pool)
+
+BOOST_AUTO_TEST_CASE(tasks){
+	Pool pool(4);
+	BOOST_CHECK_EQUAL(pool.size(), 4);
+
+	std::atomic<int> count(0);
+	for (int task = 0; task < 1000; task++) {
+		pool.submit([&](){ count++; });
+	}
+	pool.wait();
+
+	BOOST_CHECK_EQUAL(count, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(errors){
+	Pool pool(2);
+
+	pool.submit([](){ throw std::runtime_error("oops"); });
+	BOOST_CHECK_THROW(pool.wait(), std::runtime_error);
+
+	// Pool is still usable after an error
+	std::atomic<int> count(0);
+	pool.submit([&](){ count++; });
+	pool.wait();
+	BOOST_CHECK_EQUAL(count, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
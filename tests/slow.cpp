@@ -1,6 +1,8 @@
 #define BOOST_TEST_MODULE tests_slow
 #include <boost/test/unit_test.hpp>
 
+#include <set>
+
 /**
  * Slower integration tests that are run less frequently than 
  * unit tests (because they are slow)
@@ -11,6 +13,10 @@
  */
 
 #include "../model.hpp"
+#include "../lockstep.hpp"
+#include "../cohorts.hpp"
+#include "../ensemble.hpp"
+#include "../seed-sensitivity.hpp"
 
 BOOST_AUTO_TEST_SUITE(slow)
 
@@ -52,4 +58,465 @@ BOOST_AUTO_TEST_CASE(run){
 
 }
 
+/**
+ * Scenarios run in lockstep
+ */
+BOOST_AUTO_TEST_CASE(lockstep){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+    parameters.random_common = true;
+
+    // A single scenario is identical to a model run on its own
+    Model model;
+    model.context.seed(42);
+    model.initialise(parameters);
+    model.run(1900, 1920);
+
+    Lockstep single;
+    single.add("base", parameters);
+    single.seed(42);
+    single.run(1900, 1920);
+
+    for (auto year : years) {
+        for (auto region : regions) {
+            BOOST_CHECK_EQUAL(
+                single.scenarios[0]->monitor.biomass_spawners(year, region),
+                model.monitor.biomass_spawners(year, region)
+            );
+        }
+    }
+
+    // Scenarios with the same harvest settings are identical, and ones with
+    // different settings differ
+    Parameters larger = parameters;
+    larger.harvest_mls = 40;
+
+    Lockstep several;
+    several.add("base", parameters);
+    several.add("same", parameters);
+    several.add("larger", larger);
+    several.seed(42);
+    several.run(1900, 1920);
+
+    auto& base = several.scenarios[0]->monitor;
+    auto& same = several.scenarios[1]->monitor;
+    auto& different = several.scenarios[2]->monitor;
+    for (auto year : years) {
+        if (year > 1920) break;
+        for (auto region : regions) {
+            BOOST_CHECK_EQUAL(base.biomass_spawners(year, region), same.biomass_spawners(year, region));
+        }
+    }
+    BOOST_CHECK(sum(base.population_numbers) != sum(different.population_numbers));
+}
+
+/**
+ * Scenarios run in lockstep whose populations change separately (from rescaling
+ * and tag releases) still update all of their fish in each time step
+ */
+BOOST_AUTO_TEST_CASE(lockstep_rescale){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+    parameters.fishes_instances_min = 18000;
+    for (auto region : regions) {
+        for (auto method : methods) parameters.tagging_releases(1910, region, method) = 20;
+    }
+
+    // Without catch, the population is upsampled less often
+    Parameters none = parameters;
+    none.harvest_catch_history = 0;
+
+    // The first scenario has the smaller population
+    Lockstep lockstep;
+    lockstep.add("none", none);
+    lockstep.add("base", parameters);
+    lockstep.seed(42);
+
+    // The number of fish alive at the end of a step is the number updated
+    // by natural processes (in `Monitor::population()`) less those caught
+    std::vector<std::vector<double>> alive(2), updated(2);
+    std::function<void()> callback([&](){
+        auto y = year(lockstep.scenarios[0]->context.now);
+        for (unsigned int index = 0; index < 2; index++) {
+            auto& scenario = *lockstep.scenarios[index];
+            double count = 0;
+            for (const auto& fish : scenario.fishes) if (fish.alive()) count += fish.count;
+            alive[index].push_back(count);
+            double numbers = 0;
+            for (auto region : regions) numbers += scenario.monitor.population_numbers(y, region);
+            updated[index].push_back(numbers);
+        }
+    });
+    lockstep.run(1900, 1920, &callback);
+
+    auto& other = *lockstep.scenarios[0];
+    auto& base = *lockstep.scenarios[1];
+    BOOST_CHECK(base.fishes.rescales.size() > 0);
+    BOOST_CHECK(base.fishes.rescales.size() != other.fishes.rescales.size());
+    for (unsigned int step = 0; step < alive[0].size(); step++) {
+        BOOST_CHECK_EQUAL(alive[0][step], updated[0][step]);
+        BOOST_CHECK(alive[1][step] <= updated[1][step]);
+    }
+}
+
+/**
+ * Cohort-matrix model and burn in
+ */
+BOOST_AUTO_TEST_CASE(cohorts){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+
+    // Pristine spawning biomass equals B0 and catches are taken
+    Cohorts cohorts;
+    cohorts.initialise(parameters);
+    cohorts.run(1900, 1950);
+    for (auto region : regions) {
+        BOOST_CHECK_CLOSE(cohorts.monitor.biomass_spawners(1900, region), parameters.fishes_b0(region), 0.01);
+    }
+    BOOST_CHECK(sum(cohorts.harvest.catch_taken) > 0);
+
+    // The individual-based model burnt in with cohorts starts close to
+    // pristine and tracks the cohort model
+    parameters.fishes_burnin = 'c';
+    Model model;
+    model.context.seed(42);
+    model.initialise(parameters);
+    model.run(1900, 1950);
+    for (auto region : regions) {
+        BOOST_CHECK_CLOSE(model.monitor.biomass_spawners(1900, region), parameters.fishes_b0(region), 10);
+        BOOST_CHECK_CLOSE(model.monitor.biomass_spawners(1950, region), cohorts.monitor.biomass_spawners(1950, region), 20);
+    }
+}
+
+/**
+ * Monitoring records passed to a sink each year
+ */
+BOOST_AUTO_TEST_CASE(stream){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+    parameters.monitoring_programme = MonitoringComponents("CLA");
+    parameters.update();
+
+    struct Totals : MonitorSink {
+        std::map<unsigned int, double> lengths;
+        void year(const Context& context, const Monitor& monitor) override {
+            lengths[::year(context.now)] = sum(monitor.length_sample);
+        }
+    };
+    auto totals = std::make_shared<Totals>();
+
+    Model retained;
+    retained.context.seed(42);
+    retained.initialise(parameters);
+    retained.run(1900, 1950);
+
+    Model streamed;
+    streamed.context.seed(42);
+    streamed.initialise(parameters);
+    streamed.monitor.stream(totals);
+    streamed.run(1900, 1950);
+
+    // The sink gets the same records as are otherwise retained, and
+    // they are not retained when there is a sink
+    BOOST_CHECK_EQUAL(totals->lengths.size(), 51);
+    for (const auto& total : totals->lengths) {
+        double expected = 0;
+        for (auto region : regions) {
+            for (auto method : methods) {
+                for (auto length : lengths) expected += retained.monitor.length_samples(total.first, region, method, length);
+            }
+        }
+        BOOST_CHECK_EQUAL(total.second, expected);
+    }
+    BOOST_CHECK(retained.monitor.length_samples.slices() > 0);
+    BOOST_CHECK_EQUAL(streamed.monitor.length_samples.slices(), 0);
+    BOOST_CHECK_EQUAL(streamed.monitor.tagging.scanned.slices(), 0);
+}
+
+/**
+ * Petersen estimates from a simple tagging experiment (releases and
+ * scanning in the same year with no movement) are consistent with
+ * the actual population numbers
+ */
+BOOST_AUTO_TEST_CASE(petersen){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 100000;
+    parameters.fishes_movement_type = 'n';
+    for (auto region : regions) {
+        for (auto method : methods) {
+            parameters.tagging_releases(2000, region, method) = 100;
+            parameters.tagging_scanning(2000, region, method) = 1;
+        }
+    }
+
+    Model model;
+    model.context.seed(42);
+    model.initialise(parameters);
+    model.monitor.tagging.release_length_selective = false;
+    model.run(1900, 2000);
+
+    for (const auto& estimate : model.monitor.tagging.petersen(2000, 2000)) {
+        BOOST_CHECK_EQUAL(estimate.released, 400);
+        BOOST_CHECK(estimate.recaptured > 0);
+        BOOST_CHECK(std::fabs(estimate.estimate - estimate.actual) < 3 * std::sqrt(estimate.variance));
+    }
+}
+
+/**
+ * Population counts tracked each year are the same when written by
+ * a background `Writer`
+ */
+BOOST_AUTO_TEST_CASE(track){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+    parameters.fishes_track = true;
+    parameters.update();
+
+    auto counts = [&](unsigned int queue){
+        boost::filesystem::remove_all("output/fishes");
+        {
+            Model model;
+            model.context.seed(42);
+            parameters.output_queue = queue;
+            model.initialise(parameters);
+            model.run(1900, 1905);
+        }
+        std::ifstream file("output/fishes/counts.tsv");
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    };
+    auto direct = counts(0);
+    auto queued = counts(10);
+
+    BOOST_CHECK(direct.size() > 0);
+    BOOST_CHECK_EQUAL(std::count(direct.begin(), direct.end(), '\n'), 6 * Regions::size() * Sexes::size() * Ages::size() * Lengths::size());
+    BOOST_CHECK(queued == direct);
+}
+
+/**
+ * Population counts tracked in a run with `output_format` `c` are written
+ * to a columnar file
+ */
+BOOST_AUTO_TEST_CASE(track_columnar){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 20000;
+    parameters.fishes_track = true;
+    parameters.output_format = 'c';
+    parameters.update();
+
+    boost::filesystem::remove_all("output/fishes");
+    double expected = 0;
+    {
+        Model model;
+        model.context.seed(42);
+        model.initialise(parameters);
+        model.run(1900, 1905);
+        for (auto value : model.fishes.counts) expected += value;
+    }
+    BOOST_CHECK(not boost::filesystem::exists("output/fishes/counts.tsv"));
+    BOOST_REQUIRE(boost::filesystem::exists("output/fishes/counts.col"));
+
+    auto contents = Columnar::read("output/fishes/counts.col");
+    BOOST_CHECK_EQUAL(contents.dimensions.size(), 5);
+    std::set<unsigned int> times(contents.levels[0].begin(), contents.levels[0].end());
+    BOOST_CHECK_EQUAL(times.size(), 6);
+    double last = 0;
+    for (unsigned int row = 0; row < contents.values.size(); row++) {
+        if (contents.levels[0][row] == 1905) last += contents.values[row];
+    }
+    BOOST_CHECK(expected > 0);
+    BOOST_CHECK_EQUAL(last, expected);
+}
+
+/**
+ * Seed sensitivity writes a summary row for each seed number and validates
+ * the parameters for each
+ */
+BOOST_AUTO_TEST_CASE(seed_sensitivity){
+    Parameters parameters;
+    parameters.initialise();
+
+    SeedSensitivity sensitivity;
+    sensitivity.seed_numbers = {1000, 2000, 3000};
+    sensitivity.replicates = 2;
+    sensitivity.threads = 2;
+    sensitivity.seed = 42;
+    sensitivity.start = 1900;
+    sensitivity.finish = 1902;
+    sensitivity.run(parameters);
+
+    std::ifstream file("output/instances_seed_sensitivity_summary.tsv");
+    std::string line;
+    std::vector<std::string> rows;
+    while (std::getline(file, line)) rows.push_back(line);
+    BOOST_REQUIRE_EQUAL(rows.size(), 4);
+    BOOST_CHECK_EQUAL(rows[1].substr(0, 5), "1000\t");
+    BOOST_CHECK_EQUAL(rows[3].substr(0, 5), "3000\t");
+
+    // A seed number outside of the instance limits is rejected
+    parameters.fishes_instances_max = 2500;
+    BOOST_CHECK_THROW(sensitivity.run(parameters), std::runtime_error);
+}
+
+/**
+ * Read the rows of a TSV file (excluding the header) as fields
+ */
+std::vector<std::vector<std::string>> ensemble_rows(const std::string& path) {
+    std::vector<std::vector<std::string>> rows;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t')) fields.push_back(field);
+        rows.push_back(fields);
+    }
+    return rows;
+}
+
+/**
+ * Set up an ensemble with a short time period
+ */
+void ensemble_setup(Ensemble& ensemble, const std::string& directory) {
+    ensemble.directory = "output/" + directory;
+    ensemble.threads = 2;
+    ensemble.seed = 42;
+    ensemble.start = 1900;
+    ensemble.finish = 1910;
+    boost::filesystem::remove_all(ensemble.directory);
+}
+
+/**
+ * Ensembles with a precision target stop launching replicates once
+ * the target is met, or when the maximum number of replicates is reached
+ */
+BOOST_AUTO_TEST_CASE(ensemble_precision){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 2000;
+    parameters.update();
+
+    for (auto tolerance : {0.02, 0.001}) {
+        Ensemble ensemble;
+        ensemble_setup(ensemble, "ensemble-precision");
+        ensemble.replicates = 40;
+        ensemble.replicates_min = 4;
+        ensemble.tolerance = tolerance;
+        ensemble.run(parameters);
+
+        std::map<std::string, std::string> report;
+        for (const auto& row : ensemble_rows(ensemble.directory + "/summary/precision.tsv")) report[row[0]] = row[1];
+        auto precision = std::stod(report["precision"]);
+        auto completed = std::stoul(report["replicates"]);
+        BOOST_CHECK_EQUAL(ensemble_rows(ensemble.directory + "/replicates.tsv").size(), completed);
+        if (tolerance == 0.02) {
+            BOOST_CHECK_EQUAL(report["achieved"], "1");
+            BOOST_CHECK(precision <= tolerance);
+            BOOST_CHECK(completed > ensemble.replicates_min);
+            BOOST_CHECK(completed < ensemble.replicates);
+        } else {
+            BOOST_CHECK_EQUAL(report["achieved"], "0");
+            BOOST_CHECK(precision > tolerance);
+            BOOST_CHECK_EQUAL(completed, ensemble.replicates);
+        }
+    }
+}
+
+/**
+ * The variance reduction of antithetic pairs is that of the completed pairs
+ */
+BOOST_AUTO_TEST_CASE(ensemble_antithetic){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 2000;
+    parameters.update();
+
+    Ensemble ensemble;
+    ensemble_setup(ensemble, "ensemble-antithetic");
+    ensemble.replicates = 5;
+    ensemble.antithetic = true;
+    ensemble.run(parameters);
+
+    // An odd number of replicates is rounded up to complete the last pair
+    BOOST_CHECK_EQUAL(ensemble.replicates, 6);
+    BOOST_CHECK_EQUAL(ensemble_rows(ensemble.directory + "/replicates.tsv").size(), 6);
+
+    // Recalculate the reduction for biomass in the final year from the replicate outputs
+    std::map<std::string, std::map<unsigned int, double>> biomass;
+    for (const auto& row : ensemble_rows(ensemble.directory + "/biomass.tsv")) {
+        if (row[1] == "1910") biomass[row[2]][std::stoul(row[0])] = std::stod(row[3]);
+    }
+    unsigned int checked = 0;
+    for (const auto& row : ensemble_rows(ensemble.directory + "/summary/antithetic.tsv")) {
+        if (row[0] != "biomass" or row[1] != "1910") continue;
+        BOOST_CHECK_EQUAL(row[4], "3");
+
+        Moments replicates;
+        Moments pairs;
+        const auto& values = biomass[row[2]];
+        for (unsigned int pair = 0; pair < 3; pair++) {
+            replicates.append(values.at(2 * pair));
+            replicates.append(values.at(2 * pair + 1));
+            pairs.append((values.at(2 * pair) + values.at(2 * pair + 1))/2);
+        }
+        BOOST_CHECK_CLOSE(std::stod(row[5]), 1 - pairs.variance()/(replicates.variance()/2), 1e-3);
+        checked++;
+    }
+    BOOST_CHECK_EQUAL(checked, Regions::size());
+}
+
+/**
+ * The outputs of each replicate do not depend on the number of threads
+ */
+BOOST_AUTO_TEST_CASE(ensemble_threads){
+    Parameters parameters;
+    parameters.initialise();
+    parameters.fishes_seed_number = 2000;
+    parameters.update();
+
+    auto outputs = [&](unsigned int threads){
+        Ensemble ensemble;
+        ensemble_setup(ensemble, "ensemble-threads");
+        ensemble.replicates = 6;
+        ensemble.threads = threads;
+        ensemble.run(parameters);
+
+        std::vector<std::string> lines;
+        for (auto file : {"biomass.tsv", "catch.tsv", "cpue.tsv"}) {
+            for (const auto& row : ensemble_rows(ensemble.directory + "/" + file)) {
+                std::string line = file;
+                for (const auto& field : row) line += "\t" + field;
+                lines.push_back(line);
+            }
+        }
+        // Replicates are written in the order in which they finish
+        std::sort(lines.begin(), lines.end());
+        return lines;
+    };
+    auto one = outputs(1);
+    BOOST_CHECK(one.size() > 0);
+    BOOST_CHECK(outputs(3) == one);
+}
+
+/**
+ * Limits on the number of attempts when tagging or harvesting do not
+ * overflow for populations with more than 2^32 / 100 instances
+ */
+BOOST_AUTO_TEST_CASE(attempts_limit){
+    BOOST_CHECK_EQUAL(Model::attempts_limit(50000, 1), 5000000ul);
+    BOOST_CHECK_EQUAL(Model::attempts_limit(50000, 0), 5000000ul);
+    BOOST_CHECK_EQUAL(Model::attempts_limit(50000000, 1), 5000000000ul);
+    BOOST_CHECK_EQUAL(Model::attempts_limit(5000000, 10), 5000000000ul);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,45 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../sparse.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(sparse)
+
+BOOST_AUTO_TEST_CASE(same_as_dense){
+	Sparse<double, Ages> sparse;
+	Array<double, Years, Regions, Methods, Ages> dense = 0;
+	BOOST_CHECK_EQUAL(sparse.slices(), 0);
+
+	Array<double, Regions, Methods, Ages> sample = 0;
+	sample(HG, LL, 5) = 3;
+	sample(BP, RE, 30) = 1.5;
+	for (auto year : {1950u, 2010u}) {
+		for (auto region : regions) {
+			for (auto method : methods) {
+				sparse.set(year, region.index(), method.index(), sample);
+				for (auto age : ages) dense(year, region, method, age) = sample(region, method, age);
+			}
+		}
+	}
+
+	// Only slices with non-zero values are stored
+	BOOST_CHECK_EQUAL(sparse.slices(), 4);
+	BOOST_CHECK(sparse.find(1950, HG, LL));
+	BOOST_CHECK(not sparse.find(1950, HG, BT));
+	BOOST_CHECK_EQUAL(sparse(2010, BP, RE, 30), 1.5);
+	BOOST_CHECK_EQUAL(sparse(2011, BP, RE, 30), 0);
+
+	std::ostringstream expected;
+	std::ostringstream actual;
+	dense.write(expected);
+	sparse.write(actual);
+	BOOST_CHECK(actual.str() == expected.str());
+
+	// Copies are deep
+	auto copy = sparse;
+	sparse.clear();
+	BOOST_CHECK_EQUAL(sparse.slices(), 0);
+	BOOST_CHECK_EQUAL(copy(1950, HG, LL, 5), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
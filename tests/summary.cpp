@@ -0,0 +1,57 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../summary.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(summary)
+
+BOOST_AUTO_TEST_CASE(moments){
+	Moments moments;
+	for (double value : {2, 4, 4, 4, 5, 5, 7, 9}) moments.append(value);
+
+	BOOST_CHECK_EQUAL(moments.count(), 8);
+	BOOST_CHECK_CLOSE(moments.mean(), 5, 1e-9);
+	BOOST_CHECK_CLOSE(moments.variance(), 32/7.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(moments_merge){
+	Moments all, first, second;
+	for (int value = 0; value < 100; value++) {
+		all.append(value * value);
+		if (value < 30) first.append(value * value);
+		else second.append(value * value);
+	}
+	first.merge(second);
+
+	BOOST_CHECK_EQUAL(first.count(), all.count());
+	BOOST_CHECK_CLOSE(first.mean(), all.mean(), 1e-9);
+	BOOST_CHECK_CLOSE(first.variance(), all.variance(), 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(sketch_small){
+	// With few values quantiles are exact
+	Sketch sketch;
+	for (double value : {3, 1, 2}) sketch.append(value);
+
+	BOOST_CHECK_EQUAL(sketch.quantile(0), 1);
+	BOOST_CHECK_EQUAL(sketch.quantile(0.5), 2);
+	BOOST_CHECK_EQUAL(sketch.quantile(1), 3);
+}
+
+BOOST_AUTO_TEST_CASE(sketch_large){
+	// Values 0 to 99999 appended in a scrambled order to two sketches which are then merged
+	Sketch first, second;
+	for (unsigned int index = 0; index < 100000; index++) {
+		double value = (index * 7919) % 100000;
+		if (index % 2) first.append(value);
+		else second.append(value);
+	}
+	first.merge(second);
+
+	BOOST_CHECK_EQUAL(first.count(), 100000);
+	BOOST_CHECK_SMALL(first.quantile(0.025) - 2500, 100.0);
+	BOOST_CHECK_SMALL(first.quantile(0.5) - 50000, 500.0);
+	BOOST_CHECK_SMALL(first.quantile(0.975) - 97500, 100.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../sweep.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(sweep)
+
+BOOST_AUTO_TEST_CASE(latin_hypercube){
+	unsigned int points = 50;
+	auto values = Sweep::latin_hypercube(points, 6, 42);
+
+	BOOST_CHECK_EQUAL(values.size(), points);
+	// Each stratum of each dimension is sampled exactly once
+	for (unsigned int dimension = 0; dimension < 6; dimension++) {
+		std::vector<int> counts(points, 0);
+		for (const auto& point : values) {
+			BOOST_CHECK(point[dimension] >= 0 and point[dimension] < 1);
+			counts[int(point[dimension] * points)]++;
+		}
+		for (auto count : counts) BOOST_CHECK_EQUAL(count, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(sobol){
+	auto values = Sweep::sobol(64, 6);
+
+	// Known first points of the sequence
+	BOOST_CHECK_EQUAL(values[0][0], 0.5);
+	BOOST_CHECK_EQUAL(values[0][1], 0.5);
+	BOOST_CHECK_EQUAL(values[1][0], 0.75);
+	BOOST_CHECK_EQUAL(values[1][1], 0.25);
+	BOOST_CHECK_EQUAL(values[2][0], 0.25);
+	BOOST_CHECK_EQUAL(values[2][1], 0.75);
+
+	// With the origin, the first 2^k points are stratified in each dimension
+	for (unsigned int dimension = 0; dimension < 6; dimension++) {
+		std::vector<int> counts(64, 0);
+		counts[0]++;
+		for (unsigned int point = 0; point < 63; point++) counts[int(values[point][dimension] * 64)]++;
+		for (auto count : counts) BOOST_CHECK_EQUAL(count, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(apply){
+	Parameters parameters;
+	Sweep::apply(parameters, "fishes_m", 0.1);
+	Sweep::apply(parameters, "fishes_movement", 0.05);
+	parameters.update();
+
+	BOOST_CHECK_EQUAL(parameters.fishes_m, 0.1);
+	BOOST_CHECK_CLOSE(parameters.fishes_m_rate, 1 - std::exp(-0.1), 1e-9);
+	for (auto region : regions) {
+		double total = 0;
+		for (auto region_to : region_tos) total += parameters.fishes_movement(region, region_to);
+		BOOST_CHECK_CLOSE(total, 1, 1e-9);
+	}
+	BOOST_CHECK_THROW(Sweep::apply(parameters, "foo", 1), std::runtime_error);
+
+	// Movement probabilities that would make the diagonal negative
+	BOOST_CHECK_NO_THROW(Sweep::apply(parameters, "fishes_movement", 0.5));
+	BOOST_CHECK_THROW(Sweep::apply(parameters, "fishes_movement", 0.6), std::runtime_error);
+	BOOST_CHECK_NO_THROW(Sweep::check({"fishes_movement", 0, 0.5}));
+	BOOST_CHECK_THROW(Sweep::check({"fishes_movement", 0, 0.6}), std::runtime_error);
+	BOOST_CHECK_THROW(Sweep::check({"fishes_m", 0.2, 0.1}), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,250 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "../fishes.hpp"
+#include "../monitor-tagging.hpp"
+#include "../tag-archive.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(tags)
+
+BOOST_AUTO_TEST_CASE(release_recapture){
+	Tagging::Tags tags;
+	BOOST_CHECK_EQUAL(tags.size(), 0);
+
+	Fish fish;
+	fish.region = HG;
+	fish.length = 31.5;
+	tags.release(1, fish, 2000, LL);
+	fish.region = BP;
+	tags.release(2, fish, 2001, BT);
+	fish.length = 40.25;
+	tags.recapture(1, fish, 2003, RE);
+	BOOST_CHECK_EQUAL(tags.size(), 2);
+
+	auto release = tags.release(1);
+	BOOST_CHECK_EQUAL(release.time, 2000);
+	BOOST_CHECK_EQUAL(release.region, HG);
+	BOOST_CHECK_EQUAL(release.method, LL);
+	BOOST_CHECK_EQUAL(release.length, 31.5);
+
+	auto recapture = tags.recapture(1);
+	BOOST_CHECK_EQUAL(recapture.time, 2003);
+	BOOST_CHECK_EQUAL(recapture.region, BP);
+	BOOST_CHECK_EQUAL(recapture.method, RE);
+	BOOST_CHECK_EQUAL(recapture.length, 40.25);
+
+	// Not recaptured
+	BOOST_CHECK_EQUAL(tags.recapture(2).time, 0);
+}
+
+BOOST_AUTO_TEST_CASE(recorder){
+	Context context;
+	context.now = 2000;
+
+	std::vector<Fish> population(10000);
+	for (unsigned int index = 0; index < population.size(); index++) {
+		population[index].region = Region(index % 3);
+		population[index].length = 25 + index % 50;
+		population[index].tag = 0;
+		population[index].id = index + 1;
+	}
+	auto method = [](unsigned int index){ return Method(index % 4); };
+
+	// Sequential
+	auto sequential = population;
+	Tagging expected;
+	expected.initialise();
+	for (unsigned int index = 0; index < sequential.size(); index += 7) {
+		expected.release(context, sequential[index], method(index));
+	}
+
+	// Concurrent, with each thread releasing from a contiguous range of the
+	// population, recovering some fish that it released and scanning others
+	// (with imperfect detection)
+	context.parameters.tagging_detection = 0.5;
+	auto record = [&](std::vector<Fish>& fishes, Tagging& tagging, unsigned int threads){
+		TaggingRecorder recorder(threads);
+		std::vector<std::thread> workers;
+		for (unsigned int thread = 0; thread < threads; thread++) {
+			workers.emplace_back([&, thread](){
+				auto& buffer = recorder.buffer(thread);
+				auto begin = thread * fishes.size() / threads;
+				auto end = (thread + 1) * fishes.size() / threads;
+				for (auto index = begin; index < end; index++) {
+					if (index % 7 == 0) buffer.release(context, fishes[index], method(index));
+				}
+				for (auto index = begin; index < end; index++) {
+					if (index % 70 == 0) buffer.recover(context, fishes[index], RE);
+					else if (index % 7 == 0 and index % 3 == 0) buffer.scan(context, fishes[index], DS);
+				}
+			});
+		}
+		for (auto& worker : workers) worker.join();
+		recorder.merge(context, tagging);
+	};
+	auto concurrent = population;
+	Tagging actual;
+	actual.initialise();
+	record(concurrent, actual, 4);
+
+	// Tag numbers, releases and counts are the same as for a sequential pass
+	BOOST_CHECK_EQUAL(actual.number, expected.number);
+	BOOST_REQUIRE_EQUAL(actual.tags.size(), expected.tags.size());
+	for (unsigned int index = 0; index < population.size(); index++) {
+		BOOST_CHECK_EQUAL(concurrent[index].tag, sequential[index].tag);
+	}
+	for (unsigned int tag = 1; tag <= actual.tags.size(); tag++) {
+		BOOST_CHECK_EQUAL(actual.tags.release(tag).region, expected.tags.release(tag).region);
+		BOOST_CHECK_EQUAL(actual.tags.release(tag).length, expected.tags.release(tag).length);
+	}
+	BOOST_CHECK(sum(actual.released) == sum(expected.released));
+
+	// Recoveries of fish released in the same step are resolved on merge
+	for (unsigned int index = 0; index < population.size(); index += 70) {
+		BOOST_CHECK_EQUAL(actual.tags.recapture(concurrent[index].tag).method, RE);
+	}
+
+	// Scans are counted and some, but not all, scanned tags are detected
+	BOOST_CHECK_EQUAL(sum(actual.scanning), 10000 / 21 + 1 - 10000 / 210 - 1);
+	unsigned int detected = 0;
+	for (unsigned int tag = 1; tag <= actual.tags.size(); tag++) {
+		if (actual.tags.recapture(tag).method == DS and actual.tags.recapture(tag).time) detected++;
+	}
+	BOOST_CHECK(detected > 0 and detected < sum(actual.scanning));
+
+	// Detections do not depend on the number of threads (or their scheduling)
+	for (auto threads : {1u, 3u, 4u}) {
+		auto fishes = population;
+		Tagging other;
+		other.initialise();
+		record(fishes, other, threads);
+		for (unsigned int tag = 1; tag <= actual.tags.size(); tag++) {
+			BOOST_CHECK_EQUAL(other.tags.recapture(tag).time, actual.tags.recapture(tag).time);
+			BOOST_CHECK_EQUAL(other.tags.recapture(tag).method, actual.tags.recapture(tag).method);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(petersen){
+	Tagging tagging;
+	tagging.initialise();
+	tagging.population_numbers(2000, HG) = 1000;
+	tagging.released(2000, HG, LL) = 60;
+	tagging.released(2000, HG, BT) = 40;
+	tagging.scanned.slice(2001, HG, LL)(10) = 70;
+	tagging.scanned.slice(2001, HG, BT)(20) = 30;
+
+	Fish fish;
+	fish.region = HG;
+	for (unsigned int tag = 1; tag <= 100; tag++) {
+		tagging.tags.release(tag, fish, 2000, LL);
+	}
+	// Only recaptures in the same region and year are used
+	for (unsigned int tag = 1; tag <= 10; tag++) tagging.tags.recapture(tag, fish, 2001, LL);
+	for (unsigned int tag = 11; tag <= 13; tag++) tagging.tags.recapture(tag, fish, 2002, LL);
+	fish.region = BP;
+	for (unsigned int tag = 14; tag <= 15; tag++) tagging.tags.recapture(tag, fish, 2001, LL);
+
+	auto estimates = tagging.petersen(2000, 2001);
+	BOOST_REQUIRE_EQUAL(estimates.size(), 3);
+	auto estimate = estimates[HG];
+	BOOST_CHECK_EQUAL(estimate.released, 100);
+	BOOST_CHECK_EQUAL(estimate.scanned, 100);
+	BOOST_CHECK_EQUAL(estimate.recaptured, 10);
+	BOOST_CHECK_CLOSE(estimate.estimate, 101.0 * 101 / 11 - 1, 1e-6);
+	BOOST_CHECK_CLOSE(estimate.variance, 101.0 * 101 * 90 * 90 / (11 * 11 * 12), 1e-6);
+	BOOST_CHECK_EQUAL(estimate.actual, 1000);
+	BOOST_CHECK_CLOSE(estimate.error(), estimate.estimate / 1000 - 1, 1e-6);
+
+	// No releases or scans in other regions
+	BOOST_CHECK_EQUAL(estimates[BP].released, 0);
+	BOOST_CHECK_EQUAL(estimates[BP].recaptured, 0);
+	BOOST_CHECK_EQUAL(estimates[BP].estimate, 0);
+
+	// Scans must be retained
+	tagging.retain = false;
+	BOOST_CHECK_THROW(tagging.petersen(2000, 2001), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(archive){
+	// Tags released over several years and regions with some recaptured
+	Tagging::Tags tags;
+	Fish fish;
+	for (unsigned int tag = 1; tag <= 1000; tag++) {
+		fish.region = Region(tag % 3);
+		fish.length = 25 + tag % 20;
+		tags.release(tag, fish, 1990 + tag % 10, Method(tag % 4));
+		if (tag % 3 == 0) {
+			fish.region = Region((tag / 3) % 3);
+			fish.length += 1.5;
+			tags.recapture(tag, fish, 1990 + tag % 10 + tag % 7, RE);
+		}
+	}
+
+	auto path = (boost::filesystem::temp_directory_path() / "tags-test.bin").string();
+	TagArchive::write(tags, path);
+	TagArchive archive(path);
+	BOOST_CHECK_EQUAL(archive.size(), 1000);
+	BOOST_CHECK_EQUAL(archive.recaptured(), 333);
+
+	// All pairs are the same as in the database
+	auto all = archive.select();
+	BOOST_REQUIRE_EQUAL(all.size(), 1000);
+	for (const auto& pair : all) {
+		auto release = tags.release(pair.tag);
+		auto recapture = tags.recapture(pair.tag);
+		BOOST_CHECK_EQUAL(pair.release.time, release.time);
+		BOOST_CHECK_EQUAL(pair.release.region, release.region);
+		BOOST_CHECK_EQUAL(pair.release.method, release.method);
+		BOOST_CHECK_EQUAL(pair.release.length, release.length);
+		BOOST_CHECK_EQUAL(pair.recapture.time, recapture.time);
+		BOOST_CHECK_EQUAL(pair.recapture.region, recapture.region);
+		BOOST_CHECK_EQUAL(pair.recapture.length, recapture.length);
+	}
+
+	// Queries select the same pairs as a scan of the database
+	auto check = [&](const TagArchive::Query& query){
+		std::vector<unsigned int> expected;
+		for (const auto& pair : all) {
+			auto y = pair.release.time;
+			if (y < query.release_year_min or y > query.release_year_max) continue;
+			if (query.release_region >= 0 and pair.release.region != query.release_region) continue;
+			bool liberty = query.liberty_min > 0 or query.liberty_max < Years::size() - 1;
+			if ((query.recaptured or liberty) and not pair.recaptured()) continue;
+			if (liberty and (pair.liberty() < query.liberty_min or pair.liberty() > query.liberty_max)) continue;
+			expected.push_back(pair.tag);
+		}
+		std::vector<unsigned int> actual;
+		for (const auto& pair : archive.select(query)) actual.push_back(pair.tag);
+		BOOST_CHECK(actual == expected);
+		return actual.size();
+	};
+
+	TagArchive::Query query;
+	BOOST_CHECK_EQUAL(check(query), 1000);
+
+	query.release_year_min = 1993;
+	query.release_year_max = 1994;
+	BOOST_CHECK_EQUAL(check(query), 200);
+
+	query.release_region = HG;
+	check(query);
+
+	query.recaptured = true;
+	check(query);
+
+	query = TagArchive::Query();
+	query.liberty_min = 6;
+	BOOST_CHECK(check(query) > 0);
+
+	query.liberty_max = 6;
+	query.release_year_min = 1995;
+	check(query);
+
+	query = TagArchive::Query();
+	query.release_year_min = 2010;
+	BOOST_CHECK_EQUAL(check(query), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,48 @@
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <sstream>
+
+#include "../tsv.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(tsv)
+
+BOOST_AUTO_TEST_CASE(same_as_ostream){
+	std::vector<double> values = {
+		0, -0.0, 1, -1, 0.5, 1e-7, 123456, 999999, 1e6, 1234567, -1234567.89,
+		1e15, 1e16, 3.14159265, 2.5e-300, 1.0/3
+	};
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<double> uniform(-10, 10);
+	for (int index = 0; index < 10000; index++) {
+		values.push_back(std::pow(10, uniform(generator)) * (index % 2 ? 1 : -1));
+		values.push_back(std::round(uniform(generator) * 1e4));
+	}
+
+	for (int precision : {6, 3, 10}) {
+		std::ostringstream expected;
+		std::ostringstream actual;
+		expected.precision(precision);
+		{
+			Tsv tsv(actual, precision);
+			for (auto value : values) {
+				expected << value << "\t" << float(value) << "\t" << int(value) << "\t" << -42L << "\n";
+				tsv.row(value, float(value), int(value), -42L);
+			}
+		}
+		BOOST_CHECK(actual.str() == expected.str());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(strings){
+	std::ostringstream stream;
+	{
+		Tsv tsv(stream);
+		tsv << "a\t" << std::string("b") << '\n';
+		tsv.row("c", 1u, true);
+	}
+	BOOST_CHECK_EQUAL(stream.str(), "a\tb\nc\t1\t1\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
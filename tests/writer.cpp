@@ -0,0 +1,56 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../writer.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(writer)
+
+BOOST_AUTO_TEST_CASE(order){
+	Writer writer;
+
+	std::vector<int> done;
+	for (int task = 0; task < 1000; task++) {
+		writer.submit([&, task](){ done.push_back(task); }, 1);
+	}
+	writer.wait();
+
+	BOOST_REQUIRE_EQUAL(done.size(), 1000);
+	for (int task = 0; task < 1000; task++) BOOST_CHECK_EQUAL(done[task], task);
+}
+
+BOOST_AUTO_TEST_CASE(backpressure){
+	Writer writer(100);
+
+	// Each task is 60 bytes so only one can be queued at a time
+	std::atomic<int> count(0);
+	for (int task = 0; task < 10; task++) {
+		writer.submit([&](){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			count++;
+		}, 60);
+	}
+	writer.wait();
+
+	BOOST_CHECK_EQUAL(count, 10);
+	BOOST_CHECK(writer.stalls() > 0);
+
+	// A task larger than the capacity is accepted when the queue is empty
+	writer.submit([&](){ count++; }, 1000);
+	writer.wait();
+	BOOST_CHECK_EQUAL(count, 11);
+}
+
+BOOST_AUTO_TEST_CASE(errors){
+	Writer writer;
+
+	writer.submit([](){ throw std::runtime_error("oops"); }, 1);
+	BOOST_CHECK_THROW(writer.wait(), std::runtime_error);
+
+	// Writer is still usable after an error
+	std::atomic<int> count(0);
+	writer.submit([&](){ count++; }, 1);
+	writer.wait();
+	BOOST_CHECK_EQUAL(count, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
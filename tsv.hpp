@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A buffered writer of tab separated values
+ *
+ * Writing large TSV files (e.g. tag releases and recaptures, CASAL inputs and
+ * population counts) through `std::ostream::operator<<` is slow because each value
+ * goes through the stream's locale and sentry machinery. This formats values directly
+ * into a buffer (integers by hand, floating point numbers with `%g` which gives the same
+ * text as `std::ostream` at the same precision) and writes the buffer to the stream
+ * in large chunks.
+ *
+ * Values can be appended with `<<` (as for a `std::ostream`, so separators are
+ * explicit) or a whole row written, with separators, using `row()`.
+ */
+class Tsv {
+ public:
+
+    /**
+     * Create a writer
+     *
+     * @param stream The stream to write to
+     * @param precision Number of significant digits for floating point numbers
+     */
+    Tsv(std::ostream& stream, int precision = 6):
+        stream_(stream),
+        precision_(precision),
+        whole_max_(std::min(std::pow(10.0, precision), 1e15)) {
+        buffer_.reserve(capacity);
+    }
+
+    ~Tsv(void) {
+        flush();
+    }
+
+    /**
+     * Write buffered text to the stream
+     */
+    void flush(void) {
+        stream_.write(buffer_.data(), buffer_.size());
+        stream_.flush();
+        buffer_.clear();
+    }
+
+    Tsv& operator<<(const char* value) {
+        append(value, std::strlen(value));
+        return *this;
+    }
+
+    Tsv& operator<<(const std::string& value) {
+        append(value.data(), value.size());
+        return *this;
+    }
+
+    Tsv& operator<<(char value) {
+        buffer_.push_back(value);
+        check();
+        return *this;
+    }
+
+    Tsv& operator<<(bool value) {
+        buffer_.push_back(value ? '1' : '0');
+        check();
+        return *this;
+    }
+
+    Tsv& operator<<(int value) { return integer(value); }
+    Tsv& operator<<(unsigned int value) { return integer(value); }
+    Tsv& operator<<(long value) { return integer(value); }
+    Tsv& operator<<(unsigned long value) { return integer(value); }
+    Tsv& operator<<(long long value) { return integer(value); }
+    Tsv& operator<<(unsigned long long value) { return integer(value); }
+
+    Tsv& operator<<(float value) { return real(value); }
+    Tsv& operator<<(double value) { return real(value); }
+
+    /**
+     * Write a row of values separated by tabs and ending with a newline
+     */
+    template<class... Values>
+    void row(const Values&... values) {
+        fields(values...);
+    }
+
+ private:
+
+    /**
+     * Number of bytes buffered before they are written to the stream
+     */
+    static const std::size_t capacity = 1 << 16;
+
+    std::ostream& stream_;
+    int precision_;
+
+    /**
+     * Whole numbers with a magnitude less than this are written as integers
+     */
+    double whole_max_;
+
+    std::vector<char> buffer_;
+
+    void check(void) {
+        if (buffer_.size() >= capacity) {
+            stream_.write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+    }
+
+    void append(const char* data, std::size_t size) {
+        buffer_.insert(buffer_.end(), data, data + size);
+        check();
+    }
+
+    template<class Integer>
+    Tsv& integer(Integer value) {
+        char digits[24];
+        char* end = digits + sizeof(digits);
+        char* begin = end;
+        typedef typename std::make_unsigned<Integer>::type Unsigned;
+        bool negative = value < 0;
+        Unsigned magnitude = negative ? Unsigned(0) - Unsigned(value) : Unsigned(value);
+        do {
+            *--begin = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude);
+        if (negative) *--begin = '-';
+        append(begin, end - begin);
+        return *this;
+    }
+
+    Tsv& real(double value) {
+        // Whole numbers that `%g` would not write in exponent form are
+        // written as integers (the most common case for outputs like counts)
+        if (std::fabs(value) < whole_max_ and value == std::floor(value)) {
+            if (value == 0 and std::signbit(value)) return *this << "-0";
+            return integer(static_cast<long long>(value));
+        }
+        char chars[32];
+        auto size = std::snprintf(chars, sizeof(chars), "%.*g", precision_, value);
+        append(chars, size);
+        return *this;
+    }
+
+    void fields(void) {
+        *this << '\n';
+    }
+
+    template<class Value, class... Values>
+    void fields(const Value& value, const Values&... values) {
+        *this << value;
+        if (sizeof...(values)) *this << '\t';
+        fields(values...);
+    }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * A background output writer
+ *
+ * Formatting and writing outputs (e.g. in `Model::finalise()` and `Fishes::track()`)
+ * can take a significant part of a run. Instead, a simulation thread can hand off
+ * a task that writes an immutable copy of the outputs (e.g. a copy of an array
+ * or of the `Monitor`) and keep computing while a dedicated thread does the
+ * formatting and disk I/O. Tasks are run in the order they are submitted.
+ *
+ * Memory is bounded: each task is submitted with an estimate of the bytes held
+ * by its copies and `submit()` blocks while the queue holds more than `capacity`
+ * bytes (a single task larger than the capacity is accepted when the queue is empty).
+ */
+class Writer {
+ public:
+
+    typedef std::function<void()> Task;
+
+    /**
+     * Create a writer
+     *
+     * @param capacity Maximum number of bytes held by queued tasks
+     */
+    Writer(std::size_t capacity = 64e6):
+        capacity_(capacity) {
+        thread_ = std::thread([this](){ work(); });
+    }
+
+    ~Writer(void) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            finished_.wait(lock, [this](){ return tasks_.empty() and not busy_; });
+            stop_ = true;
+        }
+        available_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Submit a task, blocking while the queue is full
+     *
+     * @param task The task (should only use data that is not modified after submission)
+     * @param bytes Estimate of the bytes held by the task
+     */
+    void submit(Task task, std::size_t bytes) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (queued_ > 0 and queued_ + bytes > capacity_) {
+                stalls_++;
+                space_.wait(lock, [this, bytes](){ return queued_ == 0 or queued_ + bytes <= capacity_; });
+            }
+            queued_ += bytes;
+            tasks_.emplace_back(std::move(task), bytes);
+        }
+        available_.notify_one();
+    }
+
+    /**
+     * Wait until all submitted tasks have finished
+     *
+     * If any task threw an exception, the first one is rethrown here.
+     */
+    void wait(void) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [this](){ return tasks_.empty() and not busy_; });
+        if (error_) {
+            auto error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * Number of times that `submit()` has had to wait for space in the queue
+     */
+    unsigned int stalls(void) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stalls_;
+    }
+
+ private:
+
+    std::size_t capacity_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::condition_variable space_;
+    std::condition_variable finished_;
+    std::deque<std::pair<Task, std::size_t>> tasks_;
+    std::size_t queued_ = 0;
+    unsigned int stalls_ = 0;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    void work(void) {
+        while (true) {
+            std::pair<Task, std::size_t> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                available_.wait(lock, [this](){ return stop_ or not tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+                busy_ = true;
+            }
+
+            std::exception_ptr error;
+            try {
+                task.first();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Release the task (and the copies it holds) before making space
+            task.first = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error and not error_) error_ = error;
+                queued_ -= task.second;
+                busy_ = false;
+            }
+            space_.notify_all();
+            finished_.notify_all();
+        }
+    }
+
+};  // class Writer